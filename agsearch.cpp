@@ -4,7 +4,13 @@
 #include <cmath>
 
 #include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <memory>
+#include <array>
+#include <functional>
 #include <tuple>
+#include <type_traits>
 #include <set>
 
 namespace {
@@ -43,45 +49,127 @@ namespace {
         { 't', '\t' }, { 'v', '\v' },
     };
 
+    // code_unit_less
+    //  - orders strings by values of their code units, so that wide spellings are found by stored text of any code unit
+    //
+    struct code_unit_less {
+        using is_transparent = void;
+
+        template <typename A, typename B>
+        bool operator () (const A & a, const B & b) const {
+            return std::ranges::lexicographical_compare (a, b);
+        }
+    };
+
+    using spelling_set = std::set <std::wstring, code_unit_less>;
+
     struct alternative_spelling {
-        bool agsearch::parameter_set::* option;
-        std::set <std::wstring>         spellings;
+        bool agsearch_parameter_set::* option;
+        spelling_set                    spellings;
 
         bool operator < (const alternative_spelling & other) const noexcept {
             return this->spellings < other.spellings;
         }
     };
     static const std::set <alternative_spelling> alternative_spellings = {
-        { &agsearch::parameter_set::match_ifs_and_conditional, { L"if", L"?" } },
-        { &agsearch::parameter_set::match_class_struct_typename, { L"class", L"struct", L"typename" } },
-        { &agsearch::parameter_set::match_float_and_double_decl, { L"float", L"double" } },
-        { &agsearch::parameter_set::match_using_and_typedef, { L"using", L"typedef" } },
+        { &agsearch_parameter_set::match_ifs_and_conditional, { L"if", L"?" } },
+        { &agsearch_parameter_set::match_class_struct_typename, { L"class", L"struct", L"typename" } },
+        { &agsearch_parameter_set::match_float_and_double_decl, { L"float", L"double" } },
+        { &agsearch_parameter_set::match_using_and_typedef, { L"using", L"typedef" } },
     };
     static const std::set <alternative_spelling> alternative_spellings_optional = {
-        { &agsearch::parameter_set::match_ifs_and_conditional, { L"else", L":" } },
+        { &agsearch_parameter_set::match_ifs_and_conditional, { L"else", L":" } },
     };
 
-    struct ignored_pattern {
-        bool agsearch::parameter_set::* option;
-        std::wstring                    prefix;
-        std::set <std::wstring>         optional;
-
-        bool operator < (const ignored_pattern & other) const noexcept {
-            return std::tie (this->prefix, this->optional)
-                 < std::tie (other.prefix, other.optional);
-        }
+    // declaration specifiers
+    //  - merged into single token, see 'merge_specifiers'
+    //  - integer specifiers are counted in 4-bit fields of 'token::specifiers', access specifiers are single bits
+    //  - listed in the order in which they are spelled in the merged token
+    //
+    struct declaration_specifier {
+        std::wstring_view spelling;
+        std::uint32_t     bits;
+    };
+    static constexpr std::uint32_t implied_int = 0x0000'0100; // 'int' count
+    static constexpr std::uint32_t integer_specifiers_mask = 0x00FF'FFFF;
+    static constexpr std::uint32_t type_specifiers_mask = 0x0000'FFFF; // char, short, int, long
+
+    static constexpr declaration_specifier integer_specifiers [] = {
+        { L"signed",    0x0001'0000 },
+        { L"unsigned",  0x0010'0000 },
+        { L"char",      0x0000'0001 },
+        { L"short",     0x0000'0010 },
+        { L"long",      0x0000'1000 },
+        { L"int",       implied_int },
     };
-    static const std::set <ignored_pattern> ignored_patterns = {
-        { &agsearch::parameter_set::match_any_inheritance_type, L":", { L"virtual", L"public", L"protected", L"private" } },
-        { &agsearch::parameter_set::match_any_integer_decl_style, L"long", { L"int", L"unsigned", L"long" } },
-        { &agsearch::parameter_set::match_any_integer_decl_style, L"short", { L"int", L"unsigned" } },
-        { &agsearch::parameter_set::match_any_integer_decl_style, L"signed", { L"char", L"short", L"int", L"long" } },
-        { &agsearch::parameter_set::match_any_integer_decl_style, L"unsigned", { L"char", L"short", L"int", L"long" } },
+    static constexpr declaration_specifier access_specifiers [] = {
+        { L"virtual",   0x0100'0000 },
+        { L"public",    0x0200'0000 },
+        { L"protected", 0x0400'0000 },
+        { L"private",   0x0800'0000 },
     };
+
+    // normalized_integer_type
+    //  - integer specifiers of type declared by 'bits', spelled the shortest way
+    //  - 'int' is implied only when there's no 'char', 'short' or 'long', and 'signed' only changes 'char'
+    //
+    constexpr std::uint32_t normalized_integer_type (std::uint32_t bits) {
+        bits &= integer_specifiers_mask;
+
+        if (bits & 0x0000'000F) // char
+            return bits & ~0x0000'0F00u;
+
+        bits &= ~0x000F'0000u; // signed
+        if (bits & 0x0000'F0F0) { // short, long
+            return bits & ~0x0000'0F00u;
+        } else {
+            return (bits & ~0x0000'0F00u) | implied_int;
+        }
+    }
+
+    // equals
+    //  - compares text stored in any code unit with wide string
+    //
+    template <typename String>
+    bool equals (const String & value, std::wstring_view literal) {
+        return std::ranges::equal (value, literal);
+    }
+
+    template <std::size_t N, typename String>
+    std::uint32_t specifier_bits (const declaration_specifier (&specifiers) [N], const String & value) {
+        for (const auto & specifier : specifiers) {
+            if (std::ranges::equal (specifier.spelling, value))
+                return specifier.bits;
+        }
+        return 0;
+    }
 }
 
-void agsearch::clear () {
+template <typename Config>
+void basic_agsearch <Config>::clear () {
     this->pattern.clear ();
+    this->vocabulary.index = {};
+    this->vocabulary.entries.clear ();
+    this->vocabulary.trigrams = {};
+    this->vocabulary.subwords = {};
+    this->vocabulary.canonicals = {};
+    this->vocabulary.postings.clear ();
+    for (auto & kind : this->vocabulary.kinds) {
+        kind.clear ();
+    }
+    this->vocabulary.blocks.clear ();
+    this->vocabulary.rows.clear ();
+    this->vocabulary.numbers = {};
+    this->vocabulary.brackets.clear ();
+    this->vocabulary.open.clear ();
+    this->vocabulary.indexed = 0;
+    this->vocabulary.revision++;
+    this->plaintext.text.clear ();
+    this->plaintext.folded.clear ();
+    this->plaintext.underscores.clear ();
+    this->plaintext.pieces.clear ();
+    this->plaintext.segments.clear ();
+    this->lines.clear ();
     this->current.mode = token::type::code;
     this->current.location.row = 0;
     this->current.location.column = 0;
@@ -98,772 +186,2159 @@ namespace {
         ++it;
         return it == e;
     }
+
+    // bloom_bits
+    //  - two 13-bit indexes of 'key' in block Bloom filter of 'vocabulary_set::block_bits'
+    //
+    std::array <std::size_t, 2> bloom_bits (std::uint32_t key) {
+        const auto h = key * 0x9E37'79B9'7F4A'7C15uLL;
+        return { (std::size_t) (h >> 51), (std::size_t) ((h >> 38) & 0x1FFF) };
+    }
+
+    // cover
+    //  - adds range [begin, end) to sorted list of disjoint 'ranges', merging those it touches
+    //
+    void cover (std::vector <std::pair <std::size_t, std::size_t>> & ranges, std::size_t begin, std::size_t end) {
+        if (begin >= end)
+            return;
+
+        auto i = std::lower_bound (ranges.begin (), ranges.end (), begin,
+                                   [] (const std::pair <std::size_t, std::size_t> & r, std::size_t begin) { return r.second < begin; });
+        auto j = i;
+        while ((j != ranges.end ()) && (j->first <= end)) {
+            begin = std::min (begin, j->first);
+            end = std::max (end, j->second);
+            ++j;
+        }
+        ranges.insert (ranges.erase (i, j), { begin, end });
+    }
+
+    // clone_hash
+    //  - spreads clone key bits for rolling hash of token windows, see 'clones'
+    //
+    std::uint64_t clone_hash (std::uint64_t key) {
+        key = (key ^ (key >> 30)) * 0xBF58'476D'1CE4'E5B9uLL;
+        key = (key ^ (key >> 27)) * 0x94D0'49BB'1331'11EBuLL;
+        return key ^ (key >> 31);
+    }
+
+    // is_alternatively_spelled
+    //  - words that can match different word entirely, these can't be resolved through vocabulary
+    //
+    template <typename String>
+    bool is_alternatively_spelled (const String & value) {
+        for (auto & as : alternative_spellings) {
+            if (as.spellings.contains (value))
+                return true;
+        }
+        for (auto & as : alternative_spellings_optional) {
+            if (as.spellings.contains (value))
+                return true;
+        }
+        return false;
+    }
 }
 
-std::size_t agsearch::find (std::wstring_view needle_text) {
+template <typename Config>
+typename basic_agsearch <Config>::query basic_agsearch <Config>::compile (std::wstring_view needle_text, const query * previous) const {
+    query q;
+    q.text = needle_text;
+    q.revision = this->vocabulary.revision;
+    q.needle = std::make_unique <basic_agsearch> ();
 
     // convert needle to pattern
 
-    agsearch needle;
-    needle.parameters = this->parameters;
+    auto & needle = *q.needle;
+    if constexpr (!std::is_const_v <std::remove_reference_t <decltype (Config::parameters)>>) {
+        needle.parameters = this->parameters;
+    }
     needle.process_text (needle_text);
-    needle.normalize_needle ();
+    needle.normalize_needle (0);
+    needle.fold_plaintext ();
 
     // no cleverness about empty sets
 
-    if (!this->pattern.empty () && !needle.pattern.empty ()) {
-        
-        // basic search algorithm
-        // TODO: parallel search in 'strings' and 'reordered' - remember last result and ignore repeats
+    if (this->pattern.empty () || needle.pattern.empty ()) {
+        q.done = true;
+        return q;
+    }
+
+    // needle tokens take canonical keys from this vocabulary
+    //  - words missing in the vocabulary get 'no_key' which never equals any token
 
-        auto ipattern = this->pattern.cbegin ();
-        auto epattern = this->pattern.cend ();
-        auto is = needle.pattern.cbegin ();
-        auto es = needle.pattern.cend ();
+    for (auto & t : needle.pattern) {
+        auto canonical = this->vocabulary.canonicals->find (needle.canonical_form (needle.vocabulary.entries [t.key], t.type));
+        if (canonical != this->vocabulary.canonicals->end ()) {
+            t.canonical = canonical->second;
+        } else {
+            t.canonical = vocabulary_set::no_key;
+        }
+    }
 
-        location prev_b = { (std::uint32_t) -1, (std::uint32_t) -1 };
-        location prev_e = { (std::uint32_t) -1, (std::uint32_t) -1 };
-        std::size_t n = 0;
+    // needle that is single string or comment is searched as plain text
+    //  - string/comment tokens are never merged or reordered, so the folded text is equivalent
+    //  - but only whole words or single word, partial words of several are matched each on its own by tokens
+
+    const auto plaintext = basic_agsearch::plaintext_needle (needle);
+    if ((needle.plaintext.segments.size () == 1) && !plaintext.empty ()
+            && (this->parameters.whole_words || (needle.pattern.size () == 1))) {
+        const auto type = needle.plaintext.segments.front ().type;
+        if (std::all_of (needle.pattern.cbegin (), needle.pattern.cend (), [type] (const token & t) { return t.type == type; })) {
+            q.plaintext = true;
+            q.searcher.emplace (plaintext.begin (), plaintext.end ());
+            return q;
+        }
+    }
 
-        while (true) {
-            std::uint32_t fx = 0; // start index in partially found first token
-            std::uint32_t lx = 0; // length of partially found last token
+    // wildcards, '$' directly followed by 'id', 'num', 'any' or '...'
+    //  - '$num[low, high]' and '$num{value, ...}' restrict values of the number
 
-            auto i = ipattern;
-            auto s = is;
+    using element = typename query::element;
 
-            const std::set <std::wstring> * ignore = nullptr;
-            bool ignore_skip_prefix = false;
+    const auto adjacent = [] (const token & a, const token & b) {
+        return (a.location.row == b.location.row) && (a.location.column + a.length == b.location.column);
+    };
+    const auto values = [&needle] (std::uint32_t & i, std::vector <std::pair <double, double>> & ranges) {
+        const auto range = (needle.text (needle.pattern [i]) == L"[");
+        const auto close = range ? L"]" : L"}";
+
+        std::vector <double> numbers;
+        for (auto j = i + 1; (j + 1 < needle.pattern.size ()) && (needle.pattern [j].type == token::type::numeric); j += 2) {
+            numbers.push_back (numeric_value (needle.pattern [j]));
+
+            const auto & separator = needle.text (needle.pattern [j + 1]);
+            if (separator == close) {
+                if (range) {
+                    if (numbers.size () != 2)
+                        return false;
 
-            while (true) {
-                if (s == es) {
+                    ranges.push_back ({ numbers [0], numbers [1] });
+                } else {
+                    for (auto number : numbers) {
+                        ranges.push_back ({ number, number });
+                    }
+                    std::sort (ranges.begin (), ranges.end ());
+                }
+                i = j + 1;
+                return true;
+            }
+            if (separator != L",")
+                return false;
+        }
+        return false;
+    };
 
-                    auto lastfind = get_preceeding_iterator (i);
-                    location found_b = { ipattern->location.row, ipattern->location.column + fx };
-                    location found_e = { lastfind->location.row, lastfind->location.column + lastfind->length - lx };
+    for (std::uint32_t i = 0; i != needle.pattern.size (); ++i) {
+        const auto & t = needle.pattern [i];
+        auto type = element::type::token;
+        std::vector <std::pair <double, double>> ranges;
+
+        if ((t.type == token::type::code) && (needle.text (t) == L"$") && (i + 1 != needle.pattern.size ())) {
+            const auto & w = needle.pattern [i + 1];
+            if (adjacent (t, w)) {
+                const auto & name = needle.text (w);
+                type = (name == L"id") ? element::type::identifier
+                     : (name == L"num") ? element::type::numeric
+                     : (name == L"any") ? element::type::any
+                     : (name == L"...") ? element::type::gap
+                     : element::type::token;
+            }
+        }
+        if (type != element::type::token) {
+            ++i;
+        }
+        if ((type == element::type::numeric) && (i + 1 != needle.pattern.size ())) {
+            const auto & open = needle.pattern [i + 1];
+            if ((open.type == token::type::code) && adjacent (needle.pattern [i], open)
+                    && ((needle.text (open) == L"[") || (needle.text (open) == L"{"))) {
+
+                auto j = i + 1;
+                if (values (j, ranges)) {
+                    i = j;
+                }
+            }
+        }
+        q.elements.push_back ({ type, i, std::move (ranges) });
+    }
+    if (std::all_of (q.elements.cbegin (), q.elements.cend (), [] (const element & e) { return e.type == element::type::token; })) {
+        q.elements.clear ();
+    } else {
 
-                    if (this->found (needle_text, n++, found_b, found_e)) {
-                        std::advance (ipattern, needle.pattern.size () - 1);
+        // leading '$...' would only extend instances to the start of preceding statement
 
-                        prev_b = found_b;
-                        prev_e = found_e;
-                        break;
-                    } else
-                        return n;
+        while (!q.elements.empty () && (q.elements.front ().type == element::type::gap)) {
+            q.elements.erase (q.elements.begin ());
+        }
+        if (q.elements.empty ()) {
+            q.done = true;
+            return q;
+        }
+    }
+
+    // resolve needle words to sets of vocabulary entries that can contain them
+    //  - empty set means the token can match through other means than its text (numbers, symbols, spellings)
+
+    q.candidates.resize (needle.pattern.size ());
+    for (std::size_t i = 0; i != needle.pattern.size (); ++i) {
+        const auto & t = needle.pattern [i];
+        switch (t.type) {
+            case token::type::identifier:
+            case token::type::string:
+            case token::type::comment:
+                if (!is_alternatively_spelled (needle.text (t)) && !t.specifiers
+                        && !(this->parameters.match_any_inheritance_type && specifier_bits (access_specifiers, needle.text (t)))) {
+                    q.candidates [i] = this->resolve (needle.vocabulary.entries [t.key]);
                 }
+        }
+    }
 
-                // end of search
-                if (i == epattern)
-                    return n;
+    // needle with wildcards can span any number of blocks
+    //  - starting with '$id' or '$num' it can start only at identifiers or numbers, numbers of given values are found in 'numbers'
 
-                // check for optional patterns
-                for (const auto & ip : ignored_patterns) {
-                    if (this->parameters.*ip.option)
-                        if (s->value == ip.prefix/* && s->second.type == token::type::code or idetifier*/) {
-                            ignore = &ip.optional;
-                            ignore_skip_prefix = true;
-                            break;
-                        }
+    if (!q.elements.empty ()) {
+        const auto & first = q.elements.front ();
+        switch (first.type) {
+            case element::type::identifier:
+                q.kind = (int) token::type::identifier;
+                q.use_starts = true;
+                break;
+            case element::type::numeric:
+                if (first.ranges.empty ()) {
+                    q.kind = (int) token::type::numeric;
+                } else {
+                    const auto positions = this->numeric_positions (first.ranges);
+                    q.starts.assign (positions.cbegin (), positions.cend ());
                 }
-                bool skip = false;
-                if (ignore) {
-                    if (ignore_skip_prefix) {
-                        ignore_skip_prefix = false;
-                    } else {
-                        if (ignore->contains (i->value)) {
-                            skip = true;
-                        } else {
-                            ignore = nullptr;
-                        }
-                    }
+                q.use_starts = true;
+                break;
+            default:
+                break;
+        }
+        return q;
+    }
+
+    // blocks of tokens that can contain the needle
+    //  - every needle word with few enough candidates must have one of them in the block or in the next one,
+    //    as the needle can continue over the block boundary
+    //  - empty 'blocks' means all blocks are searched
+
+    if (needle.pattern.size () < vocabulary_set::block_size) {
+        const auto nblocks = (this->pattern.size () + vocabulary_set::block_size - 1) / vocabulary_set::block_size;
+
+        for (const auto & c : q.candidates) {
+            if (c.empty ())
+                continue;
+
+            std::vector <std::uint32_t> keys;
+            for (std::uint32_t key = 0; (key != c.size ()) && (keys.size () <= 256); ++key) {
+                if (c [key]) {
+                    keys.push_back (key);
                 }
+            }
+            if (keys.size () > 256)
+                continue;
 
-                // compare tokens properly
-                auto equivalent = this->compare_tokens (*i, *s,
-                                                        (s == is) ? &fx : nullptr,
-                                                        is_preceeding_iterator (s, es) ? &lx : nullptr);
-                if (equivalent) {
-                    ++i;
-                    ++s;
-                } else
-                if (skip) {
-                    ++i;
-                } else
-                    break;
+            std::vector <bool> contains (nblocks + 1, false);
+            for (std::size_t b = 0; b != nblocks; ++b) {
+                contains [b] = std::any_of (keys.cbegin (), keys.cend (), [this, b] (std::uint32_t key) { return this->may_contain (b, key); });
+            }
+            if (q.blocks.empty ()) {
+                q.blocks.assign (nblocks, true);
+            }
+            for (std::size_t b = 0; b != nblocks; ++b) {
+                q.blocks [b] = q.blocks [b] && (contains [b] || contains [b + 1]);
             }
-            ++ipattern;
         }
-    } else
-        return 0;
-}
+    }
 
-bool agsearch::compare_tokens (const token & a, const token & b, std::uint32_t * first, std::uint32_t * last) {
+    // partial words starting at word boundaries are found directly through subword postings
+    //  - 'starts' then lists only positions where the first needle word can match
 
-    // NOTE: 'a' is the pattern/haystack, 'b' is always the searched query/needle
+    if (this->parameters.subword_boundaries && !this->parameters.whole_words && !q.candidates.front ().empty ()) {
+        const auto & entry = needle.vocabulary.entries [needle.pattern.front ().key];
+        if (!entry.subwords.empty ()) {
+            const auto positions = this->postings (entry);
+            q.starts.assign (positions.cbegin (), positions.cend ());
+            q.use_starts = true;
+        }
+    }
 
-    if (parameters.numbers) {
-        if ((a.type == token::type::numeric) && (b.type == token::type::numeric)) {
-            
-            if (this->parameters.match_floats_and_integers) {
-                if ((a.integer == b.integer) && (a.decimal == b.decimal))
-                    return true;
+    // first needle token that can match only tokens of certain kinds restricts starts to those kinds
+    //  - strings and comments match only strings and comments respectively
+    //  - identifiers and numbers match only each other in orthogonal search, unless they match code tokens
+    //    through alternative spelling ('if' and '?') or merged specifiers ('public' and ': public')
 
-            } else {
-                if ((a.is_decimal == b.is_decimal) && (a.integer == b.integer) && (a.decimal == b.decimal))
-                    return true;
+    const auto & kinds = this->vocabulary.kinds;
+    const auto & front = needle.pattern.front ();
+    const typename vocabulary_set::positions * kind_starts = nullptr;
+    typename vocabulary_set::positions merged;
+
+    switch (front.type) {
+        case token::type::string:
+        case token::type::comment:
+            kind_starts = &kinds [(std::size_t) front.type];
+            break;
+
+        case token::type::identifier:
+        case token::type::numeric:
+            if (this->parameters.orthogonal && !front.specifiers
+                    && !is_alternatively_spelled (needle.text (front)) && !specifier_bits (access_specifiers, needle.text (front))) {
+                const auto & identifiers = kinds [(std::size_t) token::type::identifier];
+                const auto & numerics = kinds [(std::size_t) token::type::numeric];
+
+                std::merge (identifiers.cbegin (), identifiers.cend (), numerics.cbegin (), numerics.cend (), std::back_inserter (merged));
+                kind_starts = &merged;
             }
+            break;
+    }
+    if (kind_starts) {
+        if (q.use_starts) {
+            typename vocabulary_set::positions both;
+            std::set_intersection (q.starts.cbegin (), q.starts.cend (), kind_starts->cbegin (), kind_starts->cend (), std::back_inserter (both));
+            q.starts = std::move (both);
+        } else
+        if (kind_starts == &merged) {
+            q.starts = std::move (merged);
+        } else {
+            q.kind = (int) front.type;
         }
+        q.use_starts = true;
     }
 
-    if ((a.type == token::type::code) || (b.type == token::type::code)) {
+    // needle extending needle of 'previous' query can start only where the previous one matched
+    //  - only non-overlapping instances were found, positions covered by them are verified too
 
-        // fast path for language symbols comparison
+    if (previous && this->extends (*previous, q)) {
+        const auto n = previous->needle->pattern.size ();
 
-        if ((a.type == token::type::code) && (b.type == token::type::code))
-            if (a.value == b.value)
-                return true;
+        std::vector <std::uint32_t> refined;
+        refined.reserve (previous->found.size () * n);
 
-    } else {
+        for (auto start : previous->found) {
+            for (std::size_t i = 0; (i != n) && (start + i < this->pattern.size ()); ++i) {
+                refined.push_back ((std::uint32_t) (start + i));
+            }
+        }
+        std::sort (refined.begin (), refined.end ());
+        refined.erase (std::unique (refined.begin (), refined.end ()), refined.end ());
 
-        if (this->parameters.orthogonal) {
+        if (q.use_starts) {
+            const auto & positions = (q.kind >= 0) ? kinds [q.kind] : q.starts;
 
-            // code/string/comment must match in orthogonal search
-            //  - for this 'numeric' and 'identifier' are equivalent
+            std::vector <std::uint32_t> both;
+            std::set_intersection (refined.cbegin (), refined.cend (), positions.cbegin (), positions.cend (), std::back_inserter (both));
+            refined = std::move (both);
+        }
 
-            switch (b.type) {
-                case token::type::numeric:
-                case token::type::identifier:
-                    switch (a.type) {
-                        case token::type::numeric:
-                        case token::type::identifier:
-                            break;
-                        default:
-                            return false;
-                    }
-                    break;
+        q.starts.assign (refined.cbegin (), refined.cend ());
+        q.kind = -1;
+        q.use_starts = true;
+    }
+    return q;
+}
 
-                case token::type::string:
-                case token::type::comment:
-                    if (a.type != b.type)
-                        return false;
-            }
+template <typename Config>
+bool basic_agsearch <Config>::is_complete (const query & q) const {
+    return q.needle
+        && !q.plaintext
+        && q.elements.empty ()
+        && (q.revision == this->vocabulary.revision)
+        && (q.scanned.size () == 1)
+        && (q.scanned.front ().first == 0)
+        && (q.scanned.front ().second >= this->pattern.size ());
+}
 
-        } else {
+template <typename Config>
+bool basic_agsearch <Config>::extends (const query & previous, const query & q) const {
+    if (!this->is_complete (previous) || q.plaintext)
+        return false;
 
-            // if I enter regular query, I want it match everything
-            //  - if I explicitly enter "string" I want it to match only strings
-            //  - if I explicitly enter //comment I want it to match only comments
+    const auto & a = previous.needle->pattern;
+    const auto & b = q.needle->pattern;
 
-            switch (b.type) {
-                case token::type::string:
-                case token::type::comment:
-                    if (a.type != b.type)
-                        return false;
-            }
-        }
+    if (a.empty () || (a.size () > b.size ()))
+        return false;
 
-        DWORD flags = 0;
+    // all but last token of previous needle must be the same
 
-        if ((a.type == token::type::numeric) || (b.type == token::type::numeric)) {
-            if (this->parameters.case_insensitive_numbers) {
-                flags |= LINGUISTIC_IGNORECASE;// | NORM_IGNORECASE | NORM_LINGUISTIC_CASING | NORM_IGNOREWIDTH | NORM_IGNOREKANATYPE;
-            }
+    const auto same = [&previous, &q] (const token & x, const token & y) {
+        return (x.type == y.type)
+            && (x.string_type == y.string_type)
+            && (x.is_decimal == y.is_decimal)
+            && (x.opt_alt_spelling_allowed == y.opt_alt_spelling_allowed)
+            && (x.integer == y.integer)
+            && (x.decimal == y.decimal)
+            && (x.specifiers == y.specifiers)
+            && (previous.needle->text (x) == q.needle->text (y));
+    };
+
+    for (std::size_t i = 0; i != a.size () - 1; ++i) {
+        if (!same (a [i], b [i]))
+            return false;
+    }
+
+    const auto & x = a.back ();
+    const auto & y = b [a.size () - 1];
+
+    if (same (x, y))
+        return true;
+
+    // or be a plain identifier that's now typed further, which can match only within words it matched before
+    //  - last needle token matches partially, so everything new needle token matches contains it
+
+    if (this->parameters.whole_words)
+        return false;
+
+    if ((x.type != token::type::identifier) || (y.type != token::type::identifier) || x.specifiers || y.specifiers)
+        return false;
+
+    const auto & ex = previous.needle->vocabulary.entries [x.key];
+    const auto & ey = q.needle->vocabulary.entries [y.key];
+
+    for (const auto * value : { &ex.value, &ey.value }) {
+        if (is_alternatively_spelled (*value) || specifier_bits (access_specifiers, *value))
+            return false;
+    }
+
+    // both forms, through which candidate words are resolved, must extend one of previous forms
+
+    const auto extended = [&ex] (const unit_string & form) {
+        return form.starts_with (ex.form)
+            || (!ex.alternative_form.empty () && form.starts_with (ex.alternative_form));
+    };
+
+    if (!extended (ey.form) || (!ey.alternative_form.empty () && !extended (ey.alternative_form)))
+        return false;
+
+    // partial words aligned to subword boundaries must keep the boundaries
+
+    if (this->parameters.subword_boundaries) {
+        if (ex.subwords.empty () || (ex.subwords.size () > ey.subwords.size ()))
+            return false;
+
+        for (std::size_t i = 0; i != ex.subwords.size () - 1; ++i) {
+            if (ex.subwords [i].form != ey.subwords [i].form)
+                return false;
         }
-        if ((a.type == token::type::string) || (b.type == token::type::string)) {
-            if (this->parameters.case_insensitive_strings) {
-                flags |= LINGUISTIC_IGNORECASE;
+        return ey.subwords [ex.subwords.size () - 1].form.starts_with (ex.subwords.back ().form);
+    }
+    return true;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::next (query & q, match & m, std::size_t limit) const {
+    if (q.done)
+        return false;
+
+    if (q.plaintext)
+        return this->next_plaintext (q, m, limit);
+
+    if (!q.elements.empty ())
+        return this->next_automaton (q, m, limit);
+
+    // basic search algorithm
+    // TODO: parallel search in 'reordered' - remember last result and ignore repeats
+
+    const auto & needle = *q.needle;
+    const auto & positions = (q.kind >= 0) ? this->vocabulary.kinds [q.kind] : q.starts;
+    const auto from = std::min (q.position, this->pattern.size ());
+
+    auto ipattern = this->pattern.cbegin () + from;
+    auto epattern = this->pattern.cend ();
+    auto is = needle.pattern.cbegin ();
+    auto es = needle.pattern.cend ();
+
+    // no match may start at or after 'elimit' in this call, the search then continues from there next time
+
+    auto elimit = ((std::size_t) (epattern - ipattern) > limit) ? ipattern + limit : epattern;
+
+    while (true) {
+
+        // skip tokens that can't contain first word of the needle, and blocks that can't contain the needle
+
+        while (ipattern < elimit) {
+            if (q.use_starts) {
+                auto position = (std::uint32_t) (ipattern - this->pattern.cbegin ());
+                while ((q.istart != positions.size ()) && (positions [q.istart] < position)) {
+                    ++q.istart;
+                }
+                if (q.istart != positions.size ()) {
+                    ipattern = this->pattern.cbegin () + positions [q.istart];
+                } else {
+                    ipattern = epattern;
+                }
+            } else
+            if (!q.candidates.front ().empty ()) {
+                while ((ipattern < elimit) && !q.candidates.front () [ipattern->key]) {
+                    ++ipattern;
+                }
             }
-            if (this->parameters.fold_and_ignore_diacritics_strings) {
-                flags |= LINGUISTIC_IGNOREDIACRITIC;
+
+            if (q.blocks.empty () || (ipattern >= elimit))
+                break;
+
+            const auto block = (std::size_t) (ipattern - this->pattern.cbegin ()) / vocabulary_set::block_size;
+            if (q.blocks [block])
+                break;
+
+            auto next = std::find (q.blocks.cbegin () + block, q.blocks.cend (), true);
+            if (next != q.blocks.cend ()) {
+                ipattern = this->pattern.cbegin () + (next - q.blocks.cbegin ()) * vocabulary_set::block_size;
+            } else {
+                ipattern = epattern;
             }
         }
-        if ((a.type == token::type::comment) || (b.type == token::type::comment)) {
-            if (this->parameters.case_insensitive_comments) {
-                flags |= LINGUISTIC_IGNORECASE;
-            }
-            if (this->parameters.fold_and_ignore_diacritics_comments) {
-                flags |= LINGUISTIC_IGNOREDIACRITIC;
-            }
+
+        if (ipattern == epattern) {
+            cover (q.scanned, from, this->pattern.size ());
+            q.done = true;
+            return false;
         }
-        if ((a.type == token::type::identifier) || (b.type == token::type::identifier)) {
-            if (this->parameters.case_insensitive_identifiers) {
-                flags |= LINGUISTIC_IGNORECASE;// | NORM_IGNORECASE | NORM_LINGUISTIC_CASING | NORM_IGNOREWIDTH | NORM_IGNOREKANATYPE;
-            }
-            if (this->parameters.fold_and_ignore_diacritics_identifiers) {
-                flags |= LINGUISTIC_IGNOREDIACRITIC;// | NORM_IGNORENONSPACE;
-            }
+        if (ipattern >= elimit) {
+            q.position = ipattern - this->pattern.cbegin ();
+            cover (q.scanned, from, q.position);
+            return false;
         }
 
-        // compare values
+        std::uint32_t fx = 0; // start index in partially found first token
+        std::uint32_t lx = 0; // length of partially found last token
 
-        if (this->compare_strings (flags, a.value, b.value, first, last))
-            return true;
+        auto i = ipattern;
+        auto s = is;
 
-        // compare alternative
+        while (true) {
+            if (s == es) {
 
-        bool aa = !a.alternative.empty ();
-        bool ab = !b.alternative.empty ();
+                auto lastfind = get_preceeding_iterator (i);
+                m.begin = { ipattern->location.row, ipattern->location.column + fx };
+                m.end = { lastfind->location.row, lastfind->location.column + lastfind->length - lx };
 
-        if (aa || ab) {
-            if (ab) {
-                if (this->compare_strings (flags, a.value, b.alternative, first, last))
-                    return true;
-            }
-            if (aa) {
-                if (this->compare_strings (flags, a.alternative, b.value, first, last))
-                    return true;
+                q.position = (ipattern - this->pattern.cbegin ()) + needle.pattern.size ();
+                q.found.push_back ((std::uint32_t) (ipattern - this->pattern.cbegin ()));
+                cover (q.scanned, from, q.position);
+                return true;
             }
-            if (aa && ab) {
-                if (this->compare_strings (flags, a.alternative, b.alternative, first, last))
-                    return true;
+
+            // end of search
+            if (i == epattern) {
+                cover (q.scanned, from, this->pattern.size ());
+                q.done = true;
+                return false;
             }
+
+            // compare tokens properly
+            const auto & sc = q.candidates [s - is];
+            auto equivalent = (sc.empty () || sc [i->key])
+                           && this->compare_tokens (*i, *s, needle.vocabulary,
+                                                    (s == is) ? &fx : nullptr,
+                                                    is_preceeding_iterator (s, es) ? &lx : nullptr);
+            if (equivalent) {
+                ++i;
+                ++s;
+            } else
+                break;
         }
+        ++ipattern;
     }
+}
 
-    // alternative spellings
+template <typename Config>
+std::vector <std::uint32_t> basic_agsearch <Config>::numeric_positions (const std::vector <std::pair <double, double>> & ranges) const {
+    const auto & numbers = *this->vocabulary.numbers;
+    std::vector <std::uint32_t> positions;
 
-    for (auto & as : alternative_spellings) {
-        if (this->parameters.*as.option)
-            if (as.spellings.contains (a.value) && as.spellings.contains (b.value))
-                return true;
+    for (const auto & [low, high] : ranges) {
+        auto i = std::lower_bound (numbers.cbegin (), numbers.cend (), low, [] (const auto & number, double low) { return number.first < low; });
+        for (; (i != numbers.cend ()) && (i->first <= high); ++i) {
+            positions.push_back (i->second);
+        }
     }
-    if (a.opt_alt_spelling_allowed || b.opt_alt_spelling_allowed) {
-        for (auto & as : alternative_spellings_optional)
-            if (this->parameters.*as.option)
-                if (as.spellings.contains (a.value) && as.spellings.contains (b.value))
-                    return true;
+    std::sort (positions.begin (), positions.end ());
+    positions.erase (std::unique (positions.begin (), positions.end ()), positions.end ());
+    return positions;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::next_automaton (query & q, match & m, std::size_t limit) const {
+    using type = typename query::element::type;
+
+    const auto & needle = *q.needle;
+    const auto & elements = q.elements;
+    const auto n = (std::uint32_t) elements.size ();
+    const auto none = (std::size_t) -1;
+    const auto span = 256u; // tokens in '$any' or '$...', see 'compile'
+
+    // no match may start at or after 'stop' in this call, the search then continues from there next time
+
+    const auto from = std::min (q.position, this->pattern.size ());
+    const auto stop = (this->pattern.size () - from > limit) ? from + limit : this->pattern.size ();
+
+    // threads of the automaton
+    //  - thread waits for token matching its 'element', or is inside '$any' or '$...' at bracket 'depth' after 'count' tokens
+    //  - of threads in the same state only the one that started first is kept, its instance would be found first
+
+    struct thread {
+        std::uint32_t element;
+        std::uint32_t start;
+        std::uint32_t depth;
+        std::uint32_t count;
+    };
+    std::vector <thread> threads;
+    std::vector <thread> next;
+
+    // adds thread waiting for element 'e', and for following ones when '$...' can be skipped
+    //  - returns true when it got past the last element, i.e. the needle matched
+
+    const auto enter = [&elements, n] (std::vector <thread> & out, std::uint32_t e, std::uint32_t start) {
+        for (; e != n; ++e) {
+            out.push_back ({ e, start, 0, 0 });
+            if (elements [e].type != type::gap)
+                return false;
+        }
+        return true;
+    };
+    const auto bracket = [this] (const token & t) {
+        switch (this->bracket_value (t)) {
+            case L'(': case L'[': case L'{': return +1;
+            case L')': case L']': case L'}': return -1;
+        }
+        return 0;
+    };
+
+    std::size_t start = none; // of the first instance found
+    std::size_t end = none;
+
+    // with 'use_starts' threads start only at listed positions, the search skips to them when no thread is running
+
+    const auto & positions = (q.kind >= 0) ? this->vocabulary.kinds [q.kind] : q.starts;
+    if (q.use_starts) {
+        q.istart = std::lower_bound (positions.cbegin (), positions.cend (), (std::uint32_t) from) - positions.cbegin ();
     }
 
-    return false;
-}
+    for (auto p = from; p != this->pattern.size (); ++p) {
+        if (q.use_starts) {
+            while ((q.istart != positions.size ()) && (positions [q.istart] < p)) {
+                ++q.istart;
+            }
+            if (threads.empty ()) {
+                if (q.istart == positions.size ())
+                    break;
 
-bool agsearch::compare_strings (DWORD flags, const std::wstring & a, const std::wstring & b, std::uint32_t * first, std::uint32_t * last) {
-    if (this->parameters.whole_words) {
-        if (CompareStringEx (LOCALE_NAME_INVARIANT, flags,
-                             a.data (), (int) a.size (),
-                             b.data (), (int) b.size (),
-                             NULL, NULL, 0) == CSTR_EQUAL)
-            return true;
-    } else
-    if (this->parameters.individual_partial_words) {
-        if (FindNLSStringEx (LOCALE_NAME_INVARIANT, flags,
-                                a.data (), (int) a.size (),
-                                b.data (), (int) b.size (),
-                                NULL, NULL, NULL, 0) != -1)
-            return true;
-    } else {
-        if (first || last) {
-            auto length = 0;
-            auto offset = FindNLSStringEx (LOCALE_NAME_INVARIANT, flags,
-                                            a.data (), (int) a.size (),
-                                            b.data (), (int) b.size (),
-                                            &length, NULL, NULL, 0);
-            if (offset != -1) {
-                if (first) {
-                    *first = (std::uint32_t) offset;
+                p = positions [q.istart];
+            }
+        }
+        if ((start == none) && (p < stop) && (!q.use_starts || ((q.istart != positions.size ()) && (positions [q.istart] == p)))) {
+            enter (threads, 0, (std::uint32_t) p);
+        }
+        if (threads.empty ()) {
+            if (p >= stop)
+                break;
+            continue;
+        }
+
+        const auto & t = this->pattern [p];
+        const auto b = bracket (t);
+
+        next.clear ();
+        for (const auto & th : threads) {
+            const auto & e = elements [th.element];
+            auto matched = false;
+
+            switch (e.type) {
+                case type::token: {
+                    const auto & sc = q.candidates [e.token];
+                    matched = (sc.empty () || sc [t.key])
+                           && this->compare_tokens (t, needle.pattern [e.token], needle.vocabulary, nullptr, nullptr);
+                    break;
                 }
-                if (last) {
-                    *last = (std::uint32_t) (a.size () - length - offset);
+                case type::identifier:
+                    matched = (t.type == token::type::identifier);
+                    break;
+                case type::numeric:
+                    if (t.type == token::type::numeric) {
+                        const auto value = numeric_value (t);
+                        matched = e.ranges.empty ()
+                               || std::any_of (e.ranges.cbegin (), e.ranges.cend (),
+                                               [value] (const auto & range) { return (range.first <= value) && (value <= range.second); });
+                    }
+                    break;
+
+                case type::any:
+                case type::gap:
+                    if (((b < 0) && !th.depth) || (th.count == span))
+                        break;
+
+                    next.push_back ({ th.element, th.start, th.depth + b, th.count + 1 });
+                    matched = (th.depth + b == 0);
+                    break;
+            }
+
+            if (matched && enter (next, th.element + 1, th.start)) {
+                if (th.start < start) {
+                    start = th.start;
+                    end = p;
                 }
-                return true;
             }
+        }
+
+        // only threads that started before the instance found can still find one that starts earlier
+
+        if (start != none) {
+            std::erase_if (next, [start] (const thread & th) { return th.start >= start; });
+        }
+        if (next.size () > 1) {
+            std::sort (next.begin (), next.end (), [] (const thread & a, const thread & b) {
+                return std::tie (a.element, a.depth, a.count, a.start) < std::tie (b.element, b.depth, b.count, b.start);
+            });
+            next.erase (std::unique (next.begin (), next.end (), [] (const thread & a, const thread & b) {
+                return (a.element == b.element) && (a.depth == b.depth) && (a.count == b.count);
+            }), next.end ());
+        }
+        std::swap (threads, next);
+
+        if ((start != none) && threads.empty ())
+            break;
+    }
+
+    if (start == none) {
+        if (stop == this->pattern.size ()) {
+            q.done = true;
         } else {
-            if (CompareStringEx (LOCALE_NAME_INVARIANT, flags,
-                                    a.data (), (int) a.size (),
-                                    b.data (), (int) b.size (),
-                                    NULL, NULL, 0) == CSTR_EQUAL)
-                return true;
+            q.position = stop;
         }
+        return false;
     }
-    return false;
+
+    const auto & first = this->pattern [start];
+    const auto & last = this->pattern [end];
+
+    m.begin = first.location;
+    m.end = { last.location.row, last.location.column + last.length };
+
+    q.position = end + 1;
+    return true;
 }
 
-void agsearch::process_text (std::wstring_view input) {
-    auto i = std::wstring_view::npos;
-    while ((i = input.find (L'\n', i + 1)) != std::wstring_view::npos) {
-        this->process_line (input.substr (0, i));
-        input.remove_prefix (i + 1);
+template <typename Config>
+std::span <typename basic_agsearch <Config>::match> basic_agsearch <Config>::find_all (query & q, std::span <match> buffer) const {
+    std::size_t n = 0;
+    while ((n != buffer.size ()) && this->next (q, buffer [n])) {
+        ++n;
     }
-    this->process_line (input);
+    return buffer.first (n);
 }
 
-namespace {
-    bool any_of (wchar_t c, std::wstring_view sv) {
-        return sv.find (c) != std::wstring_view::npos;
+template <typename Config>
+std::size_t basic_agsearch <Config>::position (const query & q, location from) const {
+    if (q.plaintext) {
+
+        // offset of first plain text character at or after 'from'
+
+        const auto & pieces = this->plaintext.pieces;
+        auto piece = std::upper_bound (pieces.cbegin (), pieces.cend (), from,
+                                       [] (location from, const typename plaintext_set::piece & p) { return from < p.location; });
+        if (piece == pieces.cbegin ())
+            return 0;
+
+        auto next = piece--;
+        auto length = ((next != pieces.cend ()) ? next->offset : this->plaintext.text.size ()) - piece->offset;
+
+        if ((piece->location.row == from.row) && (from.column - piece->location.column < length))
+            return piece->offset + (from.column - piece->location.column);
+        else
+            return piece->offset + length;
+    } else {
+        return std::lower_bound (this->pattern.cbegin (), this->pattern.cend (), from,
+                                 [] (const token & t, location from) { return t.location < from; }) - this->pattern.cbegin ();
     }
 }
 
-bool agsearch::is_identifier_initial (wchar_t c) {
-    return std::iswalpha (c) // TODO: Unicode
-        || c == L'_'
-        ;
+template <typename Config>
+std::size_t basic_agsearch <Config>::containing (const query & q, location from) const {
+    if (q.plaintext)
+        return this->position (q, from);
+
+    // last token starting at or before 'from'
+
+    const auto i = std::upper_bound (this->pattern.cbegin (), this->pattern.cend (), from,
+                                     [] (location from, const token & t) { return from < t.location; });
+    return (i != this->pattern.cbegin ()) ? (i - this->pattern.cbegin ()) - 1 : 0;
 }
-bool agsearch::is_identifier_continuation (wchar_t c) {
-    switch (this->current.mode) {
-        case token::type::string:
-            if (parameters.ignore_accelerator_hints_in_strings) {
-                if (c == L'&')
-                    return true;
-            }
-            break;
+
+template <typename Config>
+std::pair <std::size_t, std::size_t> basic_agsearch <Config>::range (const query & q, std::uint32_t first_row, std::uint32_t last_row) const {
+    if (q.plaintext) {
+        return { this->position (q, { first_row, 0 }), this->position (q, { last_row, 0 }) };
+    } else {
+        const auto & rows = this->vocabulary.rows;
+        return {
+            (first_row < rows.size ()) ? rows [first_row] : this->pattern.size (),
+            (last_row < rows.size ()) ? rows [last_row] : this->pattern.size (),
+        };
     }
-    return std::iswalnum (c) // TODO: Unicode
-        || c == L'_'
-        ;
 }
-bool agsearch::is_numeric_initial (std::wstring_view line) {
-    return std::iswdigit (line [0])
-        || ((line.length () > 1)
-            && (line [0] == L'.')
-            && std::iswdigit (line [1]));
+
+template <typename Config>
+void basic_agsearch <Config>::seek (query & q, std::size_t position) const {
+    q.position = position;
+    q.done = false;
+
+    if (q.use_starts) {
+        const auto & positions = (q.kind >= 0) ? this->vocabulary.kinds [q.kind] : q.starts;
+        q.istart = std::lower_bound (positions.cbegin (), positions.cend (), (std::uint32_t) position) - positions.cbegin ();
+    }
 }
-std::size_t agsearch::parse_integer_part (std::wstring_view line, integer_parse_state & state) {
-    std::size_t i = 0;
 
-    if ((line.length () > 1) && (line [0] == L'0')) {
-        switch (line [1]) {
-            case L'x': case L'X': state.radix = 16; i = 2; break;
-            case L'b': case L'B': state.radix = 2;  i = 2; break;
-            default:              state.radix = 8;  i = 1; break;
-        }
+template <typename Config>
+bool basic_agsearch <Config>::find_next (query & q, location from, match & m) const {
+    if (!q.needle || q.needle->pattern.empty () || this->pattern.empty ())
+        return false;
+
+    // instance found in the token containing 'from' may start before it, e.g. partial word
+
+    this->seek (q, this->containing (q, from));
+    while (this->next (q, m)) {
+        if (!(m.begin < from))
+            return true;
     }
+    return false;
+}
 
-    for (; i != line.length (); ++i) {
-        switch (state.radix) {
-            case 16:
-                switch (line [i]) {
-                    case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
-                        state.integer *= 16;
-                        state.integer += line [i] - L'0';
-                        break;
-                    case L'a': case L'b': case L'c': case L'd': case L'e': case L'f':
-                        state.integer *= 16;
-                        state.integer += 10 + (line [i] - L'a');
-                        break;
-                    case L'A': case L'B': case L'C': case L'D': case L'E': case L'F':
-                        state.integer *= 16;
-                        state.integer += 10 + (line [i] - L'A');
-                        break;
+template <typename Config>
+bool basic_agsearch <Config>::find_previous (query & q, location from, match & m) const {
+    if (!q.needle || q.needle->pattern.empty () || this->pattern.empty ())
+        return false;
 
-                    case L'.': case L'p': case L'P':
-                        state.real = true;
-                        return i;
+    // search windows before 'from', each twice as large as previous one
+    //  - last instance in the window closest to 'from' is the result
+    //  - the first window includes token containing 'from', instance may start inside it before 'from'
 
-                    case L'\'':
-                        break;
-                    default:
-                        return i;
-                }
-                break;
+    auto end = q.plaintext ? this->position (q, from) : this->containing (q, from) + 1;
+    auto window = vocabulary_set::block_size;
 
-            case 10:
-                switch (line [i]) {
-                    case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
-                        state.integer *= 10;
-                        state.integer += line [i] - L'0';
-                        break;
-                        
-                    case L'.': case L'e': case L'E':
-                        state.real = true;
-                        return i;
+    while (end) {
+        const auto begin = (end > window) ? end - window : 0;
+        bool found = false;
+        match last;
 
-                    case L'\'':
-                        break;
-                    default:
-                        return i;
-                }
-                break;
+        this->seek (q, begin);
+        while ((q.position < end) && this->next (q, last, end - q.position)) {
+            if (last.begin < from) {
+                m = last;
+                found = true;
+            }
+        }
+        if (found)
+            return true;
 
-            case 8:
-                switch (line [i]) {
-                    case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7':
-                        state.integer *= 8;
-                        state.integer += line [i] - L'0';
-                        break;
+        end = begin;
+        window *= 2;
+    }
+    return false;
+}
 
-                    case L'\'':
-                        break;
-                    default:
-                        return i;
-                }
-                break;
+template <typename Config>
+bool basic_agsearch <Config>::satisfied (condition_state & state, const match & m) const {
+    if (state.same_body) {
+        const auto [begin, end] = this->body (m.begin);
 
-            case 2:
-                switch (line [i]) {
-                    case L'0': state.integer *= 2; break;
-                    case L'1': state.integer *= 2; ++state.integer; break;
+        // consecutive instances are mostly in the same body, searched only once
 
-                    case L'\'':
-                        break;
-                    default:
-                        return i;
-                }
-                break;
+        if ((begin < state.scope) || (state.scope < begin)) {
+            const auto last = this->position (state.q, end);
+
+            state.scope = begin;
+            this->seek (state.q, this->position (state.q, begin));
+            state.valid = (state.q.position < last) && this->next (state.q, state.current, last - state.q.position);
         }
+        return state.valid != state.negated;
     }
-    return i;
-}
 
-std::size_t agsearch::parse_decimal_part (std::wstring_view line, integer_parse_state & state) {
-    if (line [0] == L'.') {
+    const auto row = m.begin.row;
+    const auto first = (row > state.rows) ? row - state.rows : 0;
+    const auto last = (state.rows < (std::uint32_t) -1 - row) ? row + state.rows : (std::uint32_t) -1;
 
-        std::size_t i = 1;
-        for (; i != line.length (); ++i) {
+    // instances are found in order, those before 'first' are too far behind also for following instances
 
-            double multiplier = 1.0;
-            switch (state.radix) {
-                case 16:
-                    switch (line [i]) {
-                        case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
-                            multiplier /= 16.0;
-                            state.decimal += multiplier * (line [i] - L'0');
-                            break;
-                        case L'a': case L'b': case L'c': case L'd': case L'e': case L'f':
-                            multiplier /= 16.0;
-                            state.decimal += multiplier * (10 + (line [i] - L'a'));
-                            break;
-                        case L'A': case L'B': case L'C': case L'D': case L'E': case L'F':
-                            multiplier /= 16.0;
-                            state.decimal += multiplier * (10 + (line [i] - L'A'));
-                            break;
+    while ((!state.valid || (state.current.begin.row < first)) && !state.q.done) {
+        state.valid = this->next (state.q, state.current);
+    }
+    if (state.valid && (state.current.begin.row < first)) {
+        state.valid = false; // no more instances
+    }
 
-                        case L'\'':
-                            break;
-                        default:
-                            return i + this->parse_decimal_exponent (line.substr (i), state);
-                    }
-                    break;
+    const auto found = state.valid && (state.current.begin.row >= first) && (state.current.begin.row <= last);
+    return found != state.negated;
+}
 
-                case 10:
-                    switch (line [i]) {
-                        case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
-                            multiplier /= 10.0;
-                            state.decimal += multiplier * (line [i] - L'0');
-                            break;
+template <typename Config>
+bool basic_agsearch <Config>::skip (query & q, std::vector <condition_state> & states) const {
+    std::uint32_t row = 0;
 
-                        case L'\'':
-                            break;
-                        default:
-                            return i + this->parse_decimal_exponent (line.substr (i), state);
-                    }
-                    break;
+    // instance of the needle can't start more than 'rows' before the next instance of any required needle
 
-                case 8:
-                    switch (line [i]) {
-                        case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7':
-                            multiplier /= 8.0;
-                            state.decimal += multiplier * (line [i] - L'0');
-                            break;
+    for (auto & state : states) {
+        if (!state.negated && !state.same_body) {
+            if (!state.valid && !state.q.done) {
+                state.valid = this->next (state.q, state.current);
+            }
+            if (!state.valid)
+                return false;
 
-                        case L'\'':
-                            break;
-                        default:
-                            return i + this->parse_decimal_exponent (line.substr (i), state);
-                    }
-                    break;
+            if (state.current.begin.row > state.rows) {
+                row = std::max (row, state.current.begin.row - state.rows);
             }
         }
-        return i;
-    } else
-        return this->parse_decimal_exponent (line, state);
+    }
+    if (row) {
+        const auto position = this->range (q, row, row).first;
+        if (position > q.position) {
+            this->seek (q, position);
+        }
+    }
+    return true;
 }
 
-std::size_t agsearch::parse_decimal_exponent (std::wstring_view line, integer_parse_state & state) {
-    if (line.length () > 1) {
+template <typename Config>
+wchar_t basic_agsearch <Config>::bracket_value (const token & t) const {
+    if (t.type == token::type::code) {
+        const auto & value = this->stored (t);
+        if (value.length () == 1) {
+            switch (value [0]) {
+                case L'(': case L'[': case L'{':
+                case L')': case L']': case L'}':
+                    return value [0];
+            }
+        }
+    }
+    return L'\0';
+}
 
-        switch (line [0]) {
-            case L'p':
-            case L'P':
-            case L'e':
-            case L'E':
+template <typename Config>
+bool basic_agsearch <Config>::opens_namespace (std::size_t position) const {
 
-                // parse exponent
+    // '{' preceded by 'namespace' with optional (nested) name, or by 'extern' and string
 
-                std::size_t i = 1;
-                bool negative = false;
+    while (position--) {
+        const auto & t = this->pattern [position];
+        const auto & value = this->stored (t);
 
-                if (line [i] == '-') {
-                    negative = true;
-                    ++i;
-                }
-                if (i < line.length ()) {
+        switch (t.type) {
+            case token::type::identifier:
+                if (equals (value, L"namespace") || equals (value, L"extern"))
+                    return true;
+                break;
+            case token::type::string:
+                break;
+            case token::type::code:
+                if (equals (value, L":") || equals (value, L"::") || equals (value, L"\""))
+                    break;
+                [[fallthrough]];
+            default:
+                return false;
+        }
+    }
+    return false;
+}
 
-                    int exponent = 0;
-                    for (; i != line.length (); ++i) {
+template <typename Config>
+void basic_agsearch <Config>::index_bracket (std::uint32_t position) {
+    const auto value = this->bracket_value (std::as_const (this->pattern) [position]);
+    const auto namespace_body = (value == L'{') && this->opens_namespace (position);
 
-                        switch (line [i]) {
-                            case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
-                                exponent *= 10;
-                                exponent += line [i] - L'0';
-                                break;
+    this->vocabulary.brackets.push_back ({ position, vocabulary_set::no_key, 0, value, namespace_body });
+    this->pair_bracket ((std::uint32_t) this->vocabulary.brackets.size () - 1);
+}
 
-                            case L'\'':
-                                break;
-                            default:
-                                goto apply;
-                        }
-                    }
+template <typename Config>
+void basic_agsearch <Config>::pair_bracket (std::uint32_t index) {
+    auto & brackets = this->vocabulary.brackets;
+    auto & open = this->vocabulary.open;
 
-apply:
-                    if (negative) {
-                        exponent = -exponent;
-                    }
-                    state.decimal += state.integer;
-                    switch (line [0]) {
-                        case L'p':
-                        case L'P':
-                            state.decimal *= std::pow (2, exponent);
-                            break;
+    // brackets are only read here unless their pairing changes, segments shared with snapshot stay shared
 
-                        case L'e':
-                        case L'E':
-                            state.decimal *= std::pow (10.0, exponent);
-                            break;
-                    }
-                    state.integer = state.decimal;
-                    state.decimal -= state.integer;
-                    return i;
-                }
+    const auto & indexed = std::as_const (brackets);
+    const auto inner = [&indexed] (std::uint32_t i) {
+        return indexed [i].depth + ((indexed [i].value == L'{') ? 1 : 0);
+    };
+    const auto unpair = [&brackets, &indexed] (std::uint32_t i) {
+        if (indexed [i].partner != vocabulary_set::no_key) {
+            brackets [i].partner = vocabulary_set::no_key;
         }
+    };
+
+    const auto & b = indexed [index];
+    auto partner = b.partner;
+    auto depth = open.empty () ? 0 : inner (open.back ());
+
+    switch (b.value) {
+        case L'{':
+        case L'(':
+        case L'[':
+            open.push_back (index);
+            break;
+
+        default:
+            // closing bracket pairs with innermost open one of the same kind, any left open inside it stay unpaired
+            //  - e.g. those in inactive preprocessor branches
+
+            const auto opening = (b.value == L')') ? L'(' : (b.value == L']') ? L'[' : L'{';
+            const auto o = std::find_if (open.rbegin (), open.rend (), [&indexed, opening] (std::uint32_t i) { return indexed [i].value == opening; });
+
+            partner = vocabulary_set::no_key;
+            if (o != open.rend ()) {
+                partner = *o;
+                depth = indexed [*o].depth;
+                if (indexed [*o].partner != index) {
+                    brackets [*o].partner = index;
+                }
+                std::for_each (open.rbegin (), o, unpair);
+                open.erase (std::prev (o.base ()), open.end ());
+            }
+    }
+    if ((b.partner != partner) || (b.depth != depth)) {
+        auto & changed = brackets [index];
+        changed.partner = partner;
+        changed.depth = depth;
     }
-    return 0;
 }
 
-namespace {
-    template <typename C>
-    C at_or_0 (std::basic_string_view <C> & sv, std::size_t i) {
-        if (i < sv.length ()) {
-            return sv [i];
-        } else
-            return C (0);
-    }
+template <typename Config>
+void basic_agsearch <Config>::unindex_brackets (std::size_t position) {
+    auto & brackets = this->vocabulary.brackets;
+    const auto & indexed = std::as_const (brackets);
 
-    // assume line[0] == L'\'';
-    std::size_t character_literal_length (std::wstring_view line) {
-        
-        std::size_t e = 1u;
-        while (e < line.length ()) {
-            switch (line [e]) {
-                case L'\'':
-                    return e + 1;
+    brackets.resize (std::lower_bound (indexed.cbegin (), indexed.cend (), position,
+                                       [] (const auto & b, std::size_t position) { return b.position < position; }) - indexed.cbegin ());
 
-                case L'\\':
-                    e += 2;
-                    break;
+    // brackets that remain are paired again, those paired with removed ones may be paired differently
+    //  - those still open at the end aren't paired with anything
 
-                default:
-                    e += 1;
-            }
+    this->vocabulary.open.clear ();
+    for (std::uint32_t i = 0; i != indexed.size (); ++i) {
+        this->pair_bracket (i);
+    }
+    for (auto i : this->vocabulary.open) {
+        if (indexed [i].partner != vocabulary_set::no_key) {
+            brackets [i].partner = vocabulary_set::no_key;
         }
-        return line.length ();
     }
 }
 
-std::size_t agsearch::parse_numeric_suffix (std::wstring_view line, integer_parse_state & state) {
-    if (!line.empty ()) {
-        if (state.real) {
+template <typename Config>
+bool basic_agsearch <Config>::matching_bracket (location at, location & partner) const {
+    const auto & brackets = this->vocabulary.brackets;
+    const auto position = std::lower_bound (this->pattern.cbegin (), this->pattern.cend (), at,
+                                            [] (const token & t, location at) { return t.location < at; }) - this->pattern.cbegin ();
 
-            // floating-point suffixes
+    auto i = std::lower_bound (brackets.cbegin (), brackets.cend (), position,
+                               [] (const auto & b, std::size_t position) { return b.position < position; });
 
-            switch (line [0]) {
-                case L'f':
-                case L'F':
-                case L'l':
-                case L'L':
-                    return 1;
-            }
-        } else {
+    if ((i == brackets.cend ()) || (i->position != position) || (i->partner == vocabulary_set::no_key))
+        return false;
+    if ((this->pattern [position].location.row != at.row) || (this->pattern [position].location.column != at.column))
+        return false;
 
-            // integer suffixes
+    partner = this->pattern [brackets [i->partner].position].location;
+    return true;
+}
 
-            switch (line [0]) {
-                case L'u':
-                case L'U':
-                    switch (at_or_0 (line, 1)) {
-                        case L'l':
-                        case L'L':
-                            switch (at_or_0 (line, 2)) {
-                                case L'l':
-                                case L'L':
-                                    return 3;
-                            }
-                            return 2;
+template <typename Config>
+std::uint32_t basic_agsearch <Config>::depth (location at) const {
+    const auto & brackets = this->vocabulary.brackets;
 
-                        case L'z':
-                        case L'Z':
-                            return 2;
-                    }
-                    return 1;
+    // depth inside the last bracket before 'at'
 
-                case L'l':
-                case L'L':
-                    switch (at_or_0 (line, 1)) {
-                        case L'l':
-                        case L'L':
-                            switch (at_or_0 (line, 2)) {
-                                case L'u':
-                                case L'U':
-                                    return 3;
-                            }
-                            return 2;
+    auto i = std::lower_bound (brackets.cbegin (), brackets.cend (), at,
+                               [this] (const auto & b, location at) { return this->pattern [b.position].location < at; });
+    if (i == brackets.cbegin ())
+        return 0;
 
-                        case L'u':
-                        case L'U':
-                            return 2;
-                    }
-                    return 1;
+    --i;
+    return i->depth + ((i->value == L'{') ? 1 : 0);
+}
 
-                case L'z':
-                case L'Z':
-                    switch (at_or_0 (line, 1)) {
-                        case L'u':
-                        case L'U':
-                            return 2;
-                    }
-                    return 1;
-            }
+template <typename Config>
+std::pair <typename basic_agsearch <Config>::location, typename basic_agsearch <Config>::location>
+basic_agsearch <Config>::body (location at) const {
+    const auto & brackets = this->vocabulary.brackets;
+    const location end { (std::uint32_t) -1, (std::uint32_t) -1 };
+
+    // walks back from 'at' over brackets, skipping paired ones closed before it, to the first unclosed '{'
+
+    auto i = std::lower_bound (brackets.cbegin (), brackets.cend (), at,
+                               [this] (const auto & b, location at) { return this->pattern [b.position].location < at; }) - brackets.cbegin ();
+    while (i--) {
+        const auto & b = brackets [i];
+        switch (b.value) {
+            case L'{':
+                {
+                    const auto & open = this->pattern [b.position];
+                    const location begin { open.location.row, open.location.column + open.length };
+
+                    if (b.partner == vocabulary_set::no_key)
+                        return { begin, end };
+                    else
+                        return { begin, this->pattern [brackets [b.partner].position].location };
+                }
+            case L')':
+            case L']':
+            case L'}':
+                if (b.partner != vocabulary_set::no_key) {
+                    i = b.partner;
+                }
+                break;
         }
     }
-    return 0;
+    return { { 0, 0 }, end };
 }
 
-void agsearch::process_line (std::wstring_view line) {
-    
-    // un-escape and similar transformations
-    //  - 'unescaped' is local copy of 'line' in case it needs to be modified
+template <typename Config>
+std::vector <std::pair <typename basic_agsearch <Config>::location, typename basic_agsearch <Config>::location>>
+basic_agsearch <Config>::namespace_scope () const {
+    const auto & brackets = this->vocabulary.brackets;
+    std::vector <std::pair <location, location>> ranges;
 
-    std::wstring unescaped;
-    if (this->parameters.unescape/* || this->parameters.accelerators*/) {
-        // this->unescape_strings (line, unescaped);
+    // ranges between bodies other than namespace ones, each body is skipped to its closing brace
+
+    location begin { 0, 0 };
+    for (std::size_t i = 0; i < brackets.size (); ++i) {
+        const auto & b = brackets [i];
+        if ((b.value == L'{') && !b.namespace_body) {
+            ranges.push_back ({ begin, this->pattern [b.position].location });
+
+            if (b.partner == vocabulary_set::no_key)
+                return ranges;
+
+            const auto & close = this->pattern [brackets [b.partner].position];
+            begin = { close.location.row, close.location.column + close.length };
+            i = b.partner;
+        }
     }
+    ranges.push_back ({ begin, { (std::uint32_t) -1, (std::uint32_t) -1 } });
+    return ranges;
+}
 
-    // strings
+template <typename Config>
+std::uint64_t basic_agsearch <Config>::mask (query & q, const token & t) const {
+    const auto & needle = *q.needle;
 
-    /*switch (this->current.mode) {
-        case token::type::string:
-            // find ending "
-            break;
-        case token::type::code:
-            break;
-    }*/
+    // tokens with merged specifiers or optional spelling don't compare by key and type only
+    //  - numeric value is parsed from the key text
+    //  - bit 63 marks computed mask
 
-    // trim the end
-    //  - makes some options below easier
+    const auto cacheable = !t.specifiers && !t.opt_alt_spelling_allowed;
+    const auto slot = 5 * (std::size_t) t.key + (std::size_t) t.type;
 
-    line = line.substr (0, line.find_last_not_of (whitespace) + 1);
+    if (cacheable && (slot < q.masks.size ()) && q.masks [slot])
+        return q.masks [slot] & ~(1uLL << 63);
 
-    // process
+    std::uint64_t bits = 0;
+    for (std::size_t i = 0; i != needle.pattern.size (); ++i) {
+        if ((i < q.candidates.size ()) && !q.candidates [i].empty () && !q.candidates [i][t.key])
+            continue;
 
-    while (!line.empty ()) {
-next:
-        // skip whitespace
+        if (this->compare_tokens (t, needle.pattern [i], needle.vocabulary, nullptr, nullptr)) {
+            bits |= 1uLL << i;
+        }
+    }
+    if (cacheable) {
+        if (q.masks.size () <= slot) {
+            q.masks.resize (5 * this->vocabulary.entries.size ());
+        }
+        q.masks [slot] = bits | (1uLL << 63);
+    }
+    return bits;
+}
 
-        auto skipped_whitespace = line.find_first_not_of (whitespace);
-        if (skipped_whitespace != std::wstring_view::npos) {
-            this->current.location.column += skipped_whitespace;
-            line.remove_prefix (skipped_whitespace);
-        } else
-            break;
-        
+template <typename Config>
+bool basic_agsearch <Config>::next_approximate (query & q, std::size_t errors, match & m, std::size_t * found) const {
+    if (q.done || !q.needle || q.needle->pattern.empty () || (q.needle->pattern.size () > 63)) {
+        q.done = true;
+        return false;
+    }
 
-        if (this->is_numeric_initial (line)) {
+    const auto n = q.needle->pattern.size ();
+    const auto top = 1uLL << (n - 1);
+    const auto none = (std::size_t) -1;
 
-            // integers and floating point literals
+    errors = std::min (errors, n - 1); // more would match empty sequence
 
-            integer_parse_state state;
-            auto i = this->parse_integer_part (line, state);
-            if (i < line.length ()) {
-                if (state.real) {
-                    i += this->parse_decimal_part (line.substr (i), state);
-                }
-            }
-            if (i < line.length ()) {
-                i += this->parse_numeric_suffix (line.substr (i), state);
-            }
+    // bit j of 'state [d]' means first j + 1 needle tokens match tokens ending at 'position' with at most d errors
+    //  - initially first d needle tokens are matched by deleting them
 
-            this->append_numeric (line.substr (0, i), state.integer, state.real ? &state.decimal : nullptr, i);
-            line.remove_prefix (i);
+    const auto reset = [&q, errors] () {
+        q.state.resize (errors + 1);
+        for (std::size_t d = 0; d <= errors; ++d) {
+            q.state [d] = (1uLL << d) - 1;
+        }
+    };
+    const auto step = [&q, errors] (std::uint64_t bits) {
+        auto previous = q.state [0];
+        q.state [0] = ((q.state [0] << 1) | 1) & bits;
+
+        for (std::size_t d = 1; d <= errors; ++d) {
+            const auto r = q.state [d];
+            q.state [d] = (((r << 1) | 1) & bits) // match
+                        | previous // insertion
+                        | (previous << 1) | 1 // substitution
+                        | (q.state [d - 1] << 1); // deletion
+            previous = r;
+        }
+    };
+    const auto best = [&q, errors, top] () {
+        std::size_t d = 0;
+        while ((d <= errors) && !(q.state [d] & top)) {
+            ++d;
+        }
+        return d;
+    };
 
-        } else
-        if (this->is_identifier_initial (line [0])) {
+    // start of instance ending at 'end', where it needs the fewest errors, nearest to the end of those
+    //  - edit distances of needle suffixes to pattern suffixes ending there, by the pattern suffix length
 
-            // identifiers, functions, names, word operators, etc.
+    const auto start = [&] (std::size_t end) {
+        const auto first = std::max (q.earliest, (end + 1 > n + errors) ? end + 1 - n - errors : 0);
+        const auto width = end + 1 - first;
 
-            std::size_t length = 1u;
+        std::vector <std::uint64_t> bits (width + 1);
+        for (std::size_t j = 1; j <= width; ++j) {
+            bits [j] = this->mask (q, this->pattern [end + 1 - j]);
+        }
 
-            while ((length < line.length ()) && this->is_identifier_continuation (line [length])) {
-                ++length;
+        std::vector <std::size_t> row (width + 1);
+        std::vector <std::size_t> next (width + 1);
+        std::iota (row.begin (), row.end (), 0);
+
+        for (std::size_t i = 1; i <= n; ++i) {
+            next [0] = i;
+            for (std::size_t j = 1; j <= width; ++j) {
+                const auto equal = (bits [j] >> (n - i)) & 1;
+                next [j] = std::min ({ row [j - 1] + !equal, row [j] + 1, next [j - 1] + 1 });
             }
+            std::swap (row, next);
+        }
+        return end + 1 - (std::size_t) (std::min_element (row.begin () + 1, row.end ()) - row.begin ());
+    };
 
-            auto identifier = line.substr (0, length);
+    if (q.state.empty ()) {
+        reset ();
+    }
 
-            if (parameters.iso646) {
-                for (auto & [iso646, simple ] : iso646_tokens) {
-                    if (identifier == iso646) {
-                        line.remove_prefix (length);
-                        this->append_token (simple, length);
-                        goto next;
-                    }
-                }
-            }
-            if (parameters.nullptr_is_0) {
-                if (identifier == L"nullptr" || identifier == L"NULL") {
-                    line.remove_prefix (length);
-                    this->append_numeric (identifier, 0, nullptr, length);
-                    goto next;
-                }
-            }
-            if (parameters.boolean_is_integer) {
-                if (identifier == L"true" || identifier == L"false") {
-                    line.remove_prefix (length);
-                    this->append_numeric (identifier, (identifier == L"true") ? 1 : 0, nullptr, length);
-                    goto next;
-                }
+    while (q.position < this->pattern.size ()) {
+        const auto p = q.position++;
+
+        step (this->mask (q, this->pattern [p]));
+
+        // instance overlapping the pending one replaces it if it has fewer errors
+        //  - those that don't overlap are found again, scanning continues after the reported instance
+
+        const auto d = best ();
+        if ((d <= errors) && ((q.end == none) || (d < q.errors))) {
+            const auto s = start (p);
+            if ((q.end == none) || (s <= q.end)) {
+                q.start = s;
+                q.end = p;
+                q.errors = d;
             }
+        }
 
-            this->append_identifier (identifier, length);
-            line.remove_prefix (length);
+        // pending instance is reported when no overlapping instance can end any more, or it can't get better
 
-        } else {
+        if ((q.end != none) && ((q.errors == 0) || (p + 1 >= q.end + n + errors)))
+            break;
+    }
 
-            // code/comment/string switching
+    if (q.end == none) {
+        q.done = true;
+        return false;
+    }
 
-            switch (this->current.mode) {
-                case token::type::code:
-                    if (line.starts_with (L"/*")) {
-                        line.remove_prefix (2);
-                        this->current.location.column += 2;
-                        this->current.mode = token::type::comment;
+    const auto & begin = this->pattern [q.start];
+    const auto & end = this->pattern [q.end];
 
-                        goto next;
-                    }
-                    if (line.starts_with (L"//")) {
-                        line.remove_prefix (2);
-                        this->current.location.column += 2;
-                        this->current.mode = token::type::comment;
+    m.begin = begin.location;
+    m.end = { end.location.row, end.location.column + end.length };
 
-                        if (line.ends_with (L'\\')) {
-                            this->single_line_comment = 2;
-                        } else {
-                            this->single_line_comment = 1;
-                        }
+    if (found) {
+        *found = q.errors;
+    }
 
-                        goto next;
-                    }
-                    if (line.starts_with (L'\'')) {
-                        if (auto e = character_literal_length (line)) {
-                            
-                            // encode string prefix, e.g.: 'L' in L'x' 
+    q.position = q.end + 1;
+    q.earliest = q.position;
+    q.end = none;
+    reset ();
+    return true;
+}
 
-                            if (!this->pattern.empty ()) {
-                                auto & last = *this->pattern.crbegin ();
-                                if ((last.type == token::type::identifier) && (last.value.length () == 1)) {
+template <typename Config>
+typename basic_agsearch <Config>::match_range basic_agsearch <Config>::matches (std::wstring_view needle_text) const {
+    return match_range (this, this->compile (needle_text));
+}
 
-                                    this->current.string_type = (char) last.value [0];
+template <typename Config>
+std::size_t basic_agsearch <Config>::find (std::wstring_view needle_text) {
+    auto q = this->compile (needle_text);
 
-                                    // remove the token with the letter
+    match m;
+    std::size_t n = 0;
 
-                                    this->pattern.erase (get_preceeding_iterator (this->pattern.end ()));
+    while (this->next (q, m)) {
+        if (!this->found (needle_text, n++, m.begin, m.end))
+            break;
+    }
+    return n;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::compare_tokens (const token & a, const token & b, const vocabulary_set & bv, std::uint32_t * first, std::uint32_t * last) const {
+
+    // NOTE: 'a' is the pattern/haystack, 'b' is always the searched query/needle
+
+    const auto & avalue = this->vocabulary.entries [a.key].value;
+    const auto & bvalue = bv.entries [b.key].value;
+
+    // if I explicitly enter "string" I want it to match only strings
+    //  - if I explicitly enter //comment I want it to match only comments
+
+    switch (b.type) {
+        case token::type::string:
+        case token::type::comment:
+            if (a.type != b.type)
+                return false;
+    }
+
+    if ((a.specifiers & integer_specifiers_mask) && (b.specifiers & integer_specifiers_mask))
+        return includes_specifiers (a.specifiers, b.specifiers);
+
+    // access specifier searched alone, i.e. not merged with preceding ':' or ','
+
+    if ((a.specifiers & ~integer_specifiers_mask) && (b.type == token::type::identifier)) {
+        if (auto specifier = specifier_bits (access_specifiers, bvalue))
+            return includes_specifiers (a.specifiers, specifier);
+    }
+
+    if (this->parameters.numbers) {
+        if ((a.type == token::type::numeric) && (b.type == token::type::numeric)) {
+            
+            if (this->parameters.match_floats_and_integers) {
+                if ((a.integer == b.integer) && (a.decimal == b.decimal))
+                    return true;
+
+            } else {
+                if ((a.is_decimal == b.is_decimal) && (a.integer == b.integer) && (a.decimal == b.decimal))
+                    return true;
+            }
+        }
+    }
+
+    if ((a.type == token::type::code) || (b.type == token::type::code)) {
+
+        // fast path for language symbols comparison
+
+        if ((a.type == token::type::code) && (b.type == token::type::code))
+            if (avalue == bvalue)
+                return includes_specifiers (a.specifiers, b.specifiers);
+
+    } else {
+
+        if (this->parameters.orthogonal) {
+
+            // code/string/comment must match in orthogonal search
+            //  - for this 'numeric' and 'identifier' are equivalent
+
+            switch (b.type) {
+                case token::type::numeric:
+                case token::type::identifier:
+                    switch (a.type) {
+                        case token::type::numeric:
+                        case token::type::identifier:
+                            break;
+                        default:
+                            return false;
+                    }
+                    break;
+            }
+        }
+
+        // whole words of the same kind are equal when their canonical keys are
+
+        const auto whole = this->parameters.whole_words
+                        || (!this->parameters.individual_partial_words && !first && !last);
+
+        if (whole && (a.type == b.type)) {
+            if (a.canonical == b.canonical)
+                return true;
+
+        } else {
+            if (this->compare_words (a, b, bv, first, last)) {
+
+                // merged specifiers are reordered, partial match offsets wouldn't point to the source
+                if (a.specifiers) {
+                    if (first) *first = 0;
+                    if (last) *last = 0;
+                }
+                return true;
+            }
+        }
+    }
+
+    // alternative spellings
+    //  - of tokens with the specifiers merged into needle token, e.g. ': public' isn't just ':'
+
+    if (!includes_specifiers (a.specifiers, b.specifiers))
+        return false;
+
+    for (auto & as : alternative_spellings) {
+        if (this->parameters.*as.option)
+            if (as.spellings.contains (avalue) && as.spellings.contains (bvalue))
+                return true;
+    }
+    if (a.opt_alt_spelling_allowed || b.opt_alt_spelling_allowed) {
+        for (auto & as : alternative_spellings_optional)
+            if (this->parameters.*as.option)
+                if (as.spellings.contains (avalue) && as.spellings.contains (bvalue))
+                    return true;
+    }
+
+    return false;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::compare_strings (DWORD flags, unit_view stored_a, unit_view stored_b, std::uint32_t * first, std::uint32_t * last) const {
+    thread_local std::wstring buffers [2];
+    const auto a = widen (stored_a, buffers [0]);
+    const auto b = widen (stored_b, buffers [1]);
+
+    if (this->parameters.whole_words) {
+        if (CompareStringEx (LOCALE_NAME_INVARIANT, flags,
+                             a.data (), (int) a.size (),
+                             b.data (), (int) b.size (),
+                             NULL, NULL, 0) == CSTR_EQUAL)
+            return true;
+    } else
+    if (this->parameters.individual_partial_words) {
+        if (FindNLSStringEx (LOCALE_NAME_INVARIANT, flags,
+                                a.data (), (int) a.size (),
+                                b.data (), (int) b.size (),
+                                NULL, NULL, NULL, 0) != -1)
+            return true;
+    } else {
+        if (first || last) {
+            auto length = 0;
+            auto offset = FindNLSStringEx (LOCALE_NAME_INVARIANT, flags,
+                                            a.data (), (int) a.size (),
+                                            b.data (), (int) b.size (),
+                                            &length, NULL, NULL, 0);
+            if (offset != -1) {
+                if (first) {
+                    *first = (std::uint32_t) offset;
+                }
+                if (last) {
+                    *last = (std::uint32_t) (a.size () - length - offset);
+                }
+                return true;
+            }
+        } else {
+            if (CompareStringEx (LOCALE_NAME_INVARIANT, flags,
+                                    a.data (), (int) a.size (),
+                                    b.data (), (int) b.size (),
+                                    NULL, NULL, 0) == CSTR_EQUAL)
+                return true;
+        }
+    }
+    return false;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::includes_specifiers (std::uint32_t a, std::uint32_t b) {
+
+    // needle naming complete integer type must name the same type
+    //  - 'unsigned int' is 'unsigned' and 'int unsigned', but not 'unsigned short' or 'unsigned long'
+
+    if (b & type_specifiers_mask) {
+        if ((a & integer_specifiers_mask) == 0)
+            return false;
+        if (normalized_integer_type (a) != normalized_integer_type (b))
+            return false;
+
+        return (b & ~a & ~integer_specifiers_mask) == 0;
+    }
+
+    // every specifier in 'b' must be in 'a' at least as many times
+
+    for (auto i = 0u; i != 6u; ++i) {
+        if (((b >> (4 * i)) & 0xF) > ((a >> (4 * i)) & 0xF))
+            return false;
+    }
+    return (b & ~a & ~integer_specifiers_mask) == 0;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::compare_words (const token & a, const token & b, const vocabulary_set & bv, std::uint32_t * first, std::uint32_t * last) const {
+    DWORD flags = 0;
+
+    if ((a.type == token::type::numeric) || (b.type == token::type::numeric)) {
+        if (this->parameters.case_insensitive_numbers) {
+            flags |= LINGUISTIC_IGNORECASE;// | NORM_IGNORECASE | NORM_LINGUISTIC_CASING | NORM_IGNOREWIDTH | NORM_IGNOREKANATYPE;
+        }
+    }
+    if ((a.type == token::type::string) || (b.type == token::type::string)) {
+        if (this->parameters.case_insensitive_strings) {
+            flags |= LINGUISTIC_IGNORECASE;
+        }
+        if (this->parameters.fold_and_ignore_diacritics_strings) {
+            flags |= LINGUISTIC_IGNOREDIACRITIC;
+        }
+    }
+    if ((a.type == token::type::comment) || (b.type == token::type::comment)) {
+        if (this->parameters.case_insensitive_comments) {
+            flags |= LINGUISTIC_IGNORECASE;
+        }
+        if (this->parameters.fold_and_ignore_diacritics_comments) {
+            flags |= LINGUISTIC_IGNOREDIACRITIC;
+        }
+    }
+    if ((a.type == token::type::identifier) || (b.type == token::type::identifier)) {
+        if (this->parameters.case_insensitive_identifiers) {
+            flags |= LINGUISTIC_IGNORECASE;// | NORM_IGNORECASE | NORM_LINGUISTIC_CASING | NORM_IGNOREWIDTH | NORM_IGNOREKANATYPE;
+        }
+        if (this->parameters.fold_and_ignore_diacritics_identifiers) {
+            flags |= LINGUISTIC_IGNOREDIACRITIC;// | NORM_IGNORENONSPACE;
+        }
+    }
+
+    const auto & ea = this->vocabulary.entries [a.key];
+    const auto & eb = bv.entries [b.key];
+
+    if (this->parameters.subword_boundaries && !this->parameters.whole_words
+            && (this->parameters.individual_partial_words || first || last)) {
+
+        // partial words aligned to camelCase/snake_case word boundaries
+
+        if (this->compare_subwords (flags, ea, eb, first, last))
+            return true;
+
+    } else {
+
+        // compare values
+
+        if (this->compare_strings (flags, ea.value, eb.value, first, last))
+            return true;
+
+        // compare alternative
+
+        bool aa = !ea.alternative.empty ();
+        bool ab = !eb.alternative.empty ();
+
+        if (aa || ab) {
+            if (ab) {
+                if (this->compare_strings (flags, ea.value, eb.alternative, first, last))
+                    return true;
+            }
+            if (aa) {
+                if (this->compare_strings (flags, ea.alternative, eb.value, first, last))
+                    return true;
+            }
+            if (aa && ab) {
+                if (this->compare_strings (flags, ea.alternative, eb.alternative, first, last))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::compare_subwords (DWORD flags, const vocabulary_set::entry & a, const vocabulary_set::entry & b, std::uint32_t * first, std::uint32_t * last) const {
+    const auto k = b.subwords.size ();
+    const auto m = a.subwords.size ();
+
+    if ((k == 0) || (k > m))
+        return false;
+
+    // subword offsets are in wide characters, as the values were split before they were stored
+
+    thread_local std::wstring buffers [2];
+    const auto wa = widen (a.value, buffers [0]);
+    const auto wb = widen (b.value, buffers [1]);
+
+    // all subwords of 'b' must follow in 'a', the last one may be only a prefix
+
+    for (std::size_t j = 0; j != m - k + 1; ++j) {
+
+        bool aligned = true;
+        for (std::size_t t = 0; aligned && (t != k); ++t) {
+            if (t == k - 1) {
+                aligned = a.subwords [j + t].form.starts_with (b.subwords [t].form);
+            } else {
+                aligned = a.subwords [j + t].form == b.subwords [t].form;
+            }
+        }
+
+        // forms are most permissive, verify with actual 'flags'
+
+        int length = 0;
+        for (std::size_t t = 0; aligned && (t != k); ++t) {
+            const auto & sa = a.subwords [j + t];
+            const auto & sb = b.subwords [t];
+
+            if (t == k - 1) {
+                aligned = FindNLSStringEx (LOCALE_NAME_INVARIANT, flags | FIND_STARTSWITH,
+                                           wa.data () + sa.offset, (int) sa.length,
+                                           wb.data () + sb.offset, (int) sb.length,
+                                           &length, NULL, NULL, 0) == 0;
+            } else {
+                aligned = CompareStringEx (LOCALE_NAME_INVARIANT, flags,
+                                           wa.data () + sa.offset, (int) sa.length,
+                                           wb.data () + sb.offset, (int) sb.length,
+                                           NULL, NULL, 0) == CSTR_EQUAL;
+            }
+        }
+
+        if (aligned) {
+            if (!this->parameters.individual_partial_words) {
+                if (first) {
+                    *first = a.subwords [j].offset;
+                }
+                if (last) {
+                    *last = (std::uint32_t) (wa.size () - a.subwords [j + k - 1].offset - length);
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Config>
+void basic_agsearch <Config>::process_text (std::wstring_view input) {
+    std::size_t i;
+    while ((i = input.find (L'\n')) != std::wstring_view::npos) {
+        this->process_line (input.substr (0, i));
+        input.remove_prefix (i + 1);
+    }
+    this->process_line (input);
+}
+
+namespace {
+    bool any_of (wchar_t c, std::wstring_view sv) {
+        return sv.find (c) != std::wstring_view::npos;
+    }
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::is_identifier_initial (wchar_t c) {
+    return std::iswalpha (c) // TODO: Unicode
+        || c == L'_'
+        ;
+}
+template <typename Config>
+bool basic_agsearch <Config>::is_identifier_continuation (wchar_t c) {
+    switch (this->current.mode) {
+        case token::type::string:
+            if (this->parameters.ignore_accelerator_hints_in_strings) {
+                if (c == L'&')
+                    return true;
+            }
+            break;
+    }
+    return std::iswalnum (c) // TODO: Unicode
+        || c == L'_'
+        ;
+}
+template <typename Config>
+bool basic_agsearch <Config>::is_numeric_initial (std::wstring_view line) {
+    return std::iswdigit (line [0])
+        || ((line.length () > 1)
+            && (line [0] == L'.')
+            && std::iswdigit (line [1]));
+}
+template <typename Config>
+std::size_t basic_agsearch <Config>::parse_integer_part (std::wstring_view line, integer_parse_state & state) {
+    std::size_t i = 0;
+
+    if ((line.length () > 1) && (line [0] == L'0')) {
+        switch (line [1]) {
+            case L'x': case L'X': state.radix = 16; i = 2; break;
+            case L'b': case L'B': state.radix = 2;  i = 2; break;
+            default:
+
+                // leading '0' of floating point literal doesn't make it octal, e.g.: 0.5 or 017e2
+
+                const auto end = line.find_first_not_of (L"0123456789'");
+                if ((end == std::wstring_view::npos) || (std::wstring_view (L".eE").find (line [end]) == std::wstring_view::npos)) {
+                    state.radix = 8;
+                    i = 1;
+                }
+                break;
+        }
+    }
+
+    for (; i != line.length (); ++i) {
+        switch (state.radix) {
+            case 16:
+                switch (line [i]) {
+                    case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
+                        state.integer *= 16;
+                        state.integer += line [i] - L'0';
+                        break;
+                    case L'a': case L'b': case L'c': case L'd': case L'e': case L'f':
+                        state.integer *= 16;
+                        state.integer += 10 + (line [i] - L'a');
+                        break;
+                    case L'A': case L'B': case L'C': case L'D': case L'E': case L'F':
+                        state.integer *= 16;
+                        state.integer += 10 + (line [i] - L'A');
+                        break;
+
+                    case L'.': case L'p': case L'P':
+                        state.real = true;
+                        return i;
+
+                    case L'\'':
+                        break;
+                    default:
+                        return i;
+                }
+                break;
+
+            case 10:
+                switch (line [i]) {
+                    case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
+                        state.integer *= 10;
+                        state.integer += line [i] - L'0';
+                        break;
+                        
+                    case L'.': case L'e': case L'E':
+                        state.real = true;
+                        return i;
+
+                    case L'\'':
+                        break;
+                    default:
+                        return i;
+                }
+                break;
+
+            case 8:
+                switch (line [i]) {
+                    case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7':
+                        state.integer *= 8;
+                        state.integer += line [i] - L'0';
+                        break;
+
+                    case L'\'':
+                        break;
+                    default:
+                        return i;
+                }
+                break;
+
+            case 2:
+                switch (line [i]) {
+                    case L'0': state.integer *= 2; break;
+                    case L'1': state.integer *= 2; ++state.integer; break;
+
+                    case L'\'':
+                        break;
+                    default:
+                        return i;
+                }
+                break;
+        }
+    }
+    return i;
+}
+
+template <typename Config>
+std::size_t basic_agsearch <Config>::parse_decimal_part (std::wstring_view line, integer_parse_state & state) {
+    if (line [0] == L'.') {
+
+        double multiplier = 1.0;
+        std::size_t i = 1;
+        for (; i != line.length (); ++i) {
+
+            switch (state.radix) {
+                case 16:
+                    switch (line [i]) {
+                        case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
+                            multiplier /= 16.0;
+                            state.decimal += multiplier * (line [i] - L'0');
+                            break;
+                        case L'a': case L'b': case L'c': case L'd': case L'e': case L'f':
+                            multiplier /= 16.0;
+                            state.decimal += multiplier * (10 + (line [i] - L'a'));
+                            break;
+                        case L'A': case L'B': case L'C': case L'D': case L'E': case L'F':
+                            multiplier /= 16.0;
+                            state.decimal += multiplier * (10 + (line [i] - L'A'));
+                            break;
+
+                        case L'\'':
+                            break;
+                        default:
+                            return i + this->parse_decimal_exponent (line.substr (i), state);
+                    }
+                    break;
+
+                case 10:
+                    switch (line [i]) {
+                        case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
+                            multiplier /= 10.0;
+                            state.decimal += multiplier * (line [i] - L'0');
+                            break;
+
+                        case L'\'':
+                            break;
+                        default:
+                            return i + this->parse_decimal_exponent (line.substr (i), state);
+                    }
+                    break;
+
+                case 8:
+                    switch (line [i]) {
+                        case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7':
+                            multiplier /= 8.0;
+                            state.decimal += multiplier * (line [i] - L'0');
+                            break;
+
+                        case L'\'':
+                            break;
+                        default:
+                            return i + this->parse_decimal_exponent (line.substr (i), state);
+                    }
+                    break;
+            }
+        }
+        return i;
+    } else
+        return this->parse_decimal_exponent (line, state);
+}
+
+template <typename Config>
+std::size_t basic_agsearch <Config>::parse_decimal_exponent (std::wstring_view line, integer_parse_state & state) {
+    if (line.length () > 1) {
+
+        switch (line [0]) {
+            case L'p':
+            case L'P':
+            case L'e':
+            case L'E':
+
+                // parse exponent
+
+                std::size_t i = 1;
+                bool negative = false;
+
+                if (line [i] == '-') {
+                    negative = true;
+                    ++i;
+                } else
+                if (line [i] == '+') {
+                    ++i;
+                }
+                if (i < line.length ()) {
+
+                    int exponent = 0;
+                    for (; i != line.length (); ++i) {
+
+                        switch (line [i]) {
+                            case L'0': case L'1': case L'2': case L'3': case L'4': case L'5': case L'6': case L'7': case L'8': case L'9':
+                                exponent *= 10;
+                                exponent += line [i] - L'0';
+                                break;
+
+                            case L'\'':
+                                break;
+                            default:
+                                goto apply;
+                        }
+                    }
+
+apply:
+                    if (negative) {
+                        exponent = -exponent;
+                    }
+                    state.decimal += state.integer;
+                    switch (line [0]) {
+                        case L'p':
+                        case L'P':
+                            state.decimal *= std::pow (2, exponent);
+                            break;
+
+                        case L'e':
+                        case L'E':
+                            state.decimal *= std::pow (10.0, exponent);
+                            break;
+                    }
+                    state.integer = state.decimal;
+                    state.decimal -= state.integer;
+                    return i;
+                }
+        }
+    }
+    return 0;
+}
+
+namespace {
+    template <typename C>
+    C at_or_0 (std::basic_string_view <C> & sv, std::size_t i) {
+        if (i < sv.length ()) {
+            return sv [i];
+        } else
+            return C (0);
+    }
+
+    // assume line[0] == L'\'';
+    std::size_t character_literal_length (std::wstring_view line) {
+        
+        std::size_t e = 1u;
+        while (e < line.length ()) {
+            switch (line [e]) {
+                case L'\'':
+                    return e + 1;
+
+                case L'\\':
+                    e += 2;
+                    break;
+
+                default:
+                    e += 1;
+            }
+        }
+        return line.length ();
+    }
+}
+
+template <typename Config>
+std::size_t basic_agsearch <Config>::parse_numeric_suffix (std::wstring_view line, integer_parse_state & state) {
+    if (!line.empty ()) {
+        if (state.real) {
+
+            // floating-point suffixes
+
+            switch (line [0]) {
+                case L'f':
+                case L'F':
+                case L'l':
+                case L'L':
+                    return 1;
+            }
+        } else {
+
+            // integer suffixes
+
+            switch (line [0]) {
+                case L'u':
+                case L'U':
+                    switch (at_or_0 (line, 1)) {
+                        case L'l':
+                        case L'L':
+                            switch (at_or_0 (line, 2)) {
+                                case L'l':
+                                case L'L':
+                                    return 3;
+                            }
+                            return 2;
+
+                        case L'z':
+                        case L'Z':
+                            return 2;
+                    }
+                    return 1;
+
+                case L'l':
+                case L'L':
+                    switch (at_or_0 (line, 1)) {
+                        case L'l':
+                        case L'L':
+                            switch (at_or_0 (line, 2)) {
+                                case L'u':
+                                case L'U':
+                                    return 3;
+                            }
+                            return 2;
+
+                        case L'u':
+                        case L'U':
+                            return 2;
+                    }
+                    return 1;
+
+                case L'z':
+                case L'Z':
+                    switch (at_or_0 (line, 1)) {
+                        case L'u':
+                        case L'U':
+                            return 2;
+                    }
+                    return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+template <typename Config>
+void basic_agsearch <Config>::process_line (std::wstring_view line) {
+    this->lines.push_back ({
+        std::hash <std::wstring_view> {} (line),
+        (std::uint32_t) this->pattern.size (),
+        (std::uint32_t) this->plaintext.text.size (),
+        (std::uint32_t) this->plaintext.pieces.size (),
+        (std::uint32_t) this->plaintext.segments.size (),
+        this->plaintext.text.empty () ? code_unit {} : std::as_const (this->plaintext.text).back (),
+        this->plaintext.segments.empty () ? typename plaintext_set::segment {} : std::as_const (this->plaintext.segments).back (),
+        this->current,
+        this->single_line_comment,
+        false
+    });
+
+    // un-escape and similar transformations
+    //  - 'unescaped' is local copy of 'line' in case it needs to be modified
+
+    std::wstring unescaped;
+    if (this->parameters.unescape/* || this->parameters.accelerators*/) {
+        // this->unescape_strings (line, unescaped);
+    }
+
+    // strings
+
+    /*switch (this->current.mode) {
+        case token::type::string:
+            // find ending "
+            break;
+        case token::type::code:
+            break;
+    }*/
+
+    // trim the end
+    //  - makes some options below easier
+
+    line = line.substr (0, line.find_last_not_of (whitespace) + 1);
+
+    // continued multi-line string or comment
+
+    const auto source = line;
+    if (this->current.mode != token::type::code) {
+        this->current.plaintext = 0;
+    }
+
+    // process
+
+    while (!line.empty ()) {
+next:
+        // skip whitespace
+
+        auto skipped_whitespace = line.find_first_not_of (whitespace);
+        if (skipped_whitespace != std::wstring_view::npos) {
+            this->current.location.column += skipped_whitespace;
+            line.remove_prefix (skipped_whitespace);
+        } else
+            break;
+        
+
+        if (this->is_numeric_initial (line)) {
+
+            // integers and floating point literals
+
+            integer_parse_state state;
+            auto i = this->parse_integer_part (line, state);
+            if (i < line.length ()) {
+                if (state.real) {
+                    i += this->parse_decimal_part (line.substr (i), state);
+                }
+            }
+            if (i < line.length ()) {
+                i += this->parse_numeric_suffix (line.substr (i), state);
+            }
+
+            this->append_numeric (line.substr (0, i), state.integer, state.real ? &state.decimal : nullptr, i);
+            line.remove_prefix (i);
+
+        } else
+        if (this->is_identifier_initial (line [0])) {
+
+            // identifiers, functions, names, word operators, etc.
+
+            std::size_t length = 1u;
+
+            while ((length < line.length ()) && this->is_identifier_continuation (line [length])) {
+                ++length;
+            }
+
+            auto identifier = line.substr (0, length);
+
+            if (this->parameters.iso646) {
+                for (auto & [iso646, simple ] : iso646_tokens) {
+                    if (identifier == iso646) {
+                        line.remove_prefix (length);
+                        this->append_token (simple, length);
+                        goto next;
+                    }
+                }
+            }
+            if (this->parameters.nullptr_is_0) {
+                if (identifier == L"nullptr" || identifier == L"NULL") {
+                    line.remove_prefix (length);
+                    this->append_numeric (identifier, 0, nullptr, length);
+                    goto next;
+                }
+            }
+            if (this->parameters.boolean_is_integer) {
+                if (identifier == L"true" || identifier == L"false") {
+                    line.remove_prefix (length);
+                    this->append_numeric (identifier, (identifier == L"true") ? 1 : 0, nullptr, length);
+                    goto next;
+                }
+            }
+
+            this->append_identifier (identifier, length);
+            line.remove_prefix (length);
+
+        } else {
+
+            // code/comment/string switching
+
+            switch (this->current.mode) {
+                case token::type::code:
+                    if (line.starts_with (L"/*")) {
+                        line.remove_prefix (2);
+                        this->current.location.column += 2;
+                        this->current.mode = token::type::comment;
+                        this->open_plaintext ();
+
+                        goto next;
+                    }
+                    if (line.starts_with (L"//")) {
+                        line.remove_prefix (2);
+                        this->current.location.column += 2;
+                        this->current.mode = token::type::comment;
+
+                        if (line.ends_with (L'\\')) {
+                            this->single_line_comment = 2;
+                        } else {
+                            this->single_line_comment = 1;
+                        }
+                        this->open_plaintext ();
+
+                        goto next;
+                    }
+                    if (line.starts_with (L'\'')) {
+                        if (auto e = character_literal_length (line)) {
+                            
+                            // encode string prefix, e.g.: 'L' in L'x' 
+
+                            if (!this->pattern.empty ()) {
+                                auto & last = *this->pattern.crbegin ();
+                                if ((last.type == token::type::identifier) && (this->stored (last).length () == 1)) {
+
+                                    this->current.string_type = (char) this->stored (last) [0];
+
+                                    // remove the token with the letter
+
+                                    this->remove_last_token ();
                                 }
                             }
                             
@@ -885,253 +2360,928 @@ next:
 
                         if (!this->pattern.empty ()) {
                             auto & last = *this->pattern.crbegin ();
-                            if ((last.type == token::type::identifier) && (last.value.length () == 1)) {
+                            if ((last.type == token::type::identifier) && (this->stored (last).length () == 1)) {
                                 
-                                this->current.string_type = (char) last.value [0];
+                                this->current.string_type = (char) this->stored (last) [0];
+
+                                // remove the token with the letter
+
+                                this->remove_last_token ();
+                            }
+                        }
+                        this->open_plaintext ();
+                        goto next;
+                    }
+                    break;
+
+                case token::type::comment:
+                    if (line.starts_with (L"*/") && !this->single_line_comment) {
+                        this->append_plaintext (source.substr (this->current.plaintext, this->current.location.column - this->current.plaintext),
+                                                { this->current.location.row, this->current.plaintext });
+                        this->close_plaintext ();
+
+                        line.remove_prefix (2);
+                        this->current.location.column += 2;
+                        this->current.mode = token::type::code;
+
+                        goto next;
+                    }
+                    if (this->parameters.undecorate_comments) {
+                        if (line.starts_with (L'*') || line.starts_with (L'/')) {
+                            line.remove_prefix (1);
+                            this->current.location.column += 1;
+                            goto next;
+                        }
+                    }
+                    break;
+
+                case token::type::string:
+                    if (line.starts_with (L"\\\"")) {
+                        line.remove_prefix (2);
+                        this->append_token (L"\"", 2);
+
+                        goto next;
+                    }
+                    if (line.starts_with (L'"')) {
+                        this->append_plaintext (source.substr (this->current.plaintext, this->current.location.column - this->current.plaintext),
+                                                { this->current.location.row, this->current.plaintext });
+                        this->close_plaintext ();
+
+                        line.remove_prefix (1);
+                        this->current.location.column += 1;
+                        this->current.mode = token::type::code;
+                        this->current.string_type = 0;
+
+                        goto next;
+                    }
+                    break;
+            }
+
+            for (auto & mct : multi_character_tokens) {
+                if (line.starts_with (mct)) {
+                    line.remove_prefix (mct.length ());
+
+                    if (this->parameters.ignore_all_syntactic_tokens) {
+                        this->current.location.column += mct.length ();
+                    } else {
+                        this->append_token (mct, mct.length ());
+                    }
+                    goto next;
+                }
+            }
+
+            if (this->parameters.digraphs) {
+                for (auto & digraph : alternative_tokens) {
+                    if (line.starts_with (digraph.first)) {
+                        line.remove_prefix (digraph.first.length ());
+
+                        if (this->parameters.ignore_all_syntactic_tokens) {
+                            this->current.location.column += digraph.first.length ();
+                        } else {
+                            this->append_token (digraph.second);
+                        }
+                        goto next;
+                    }
+                }
+            }
+
+            if (this->parameters.trigraphs) {
+                for (auto & trigraph : trigraph_tokens) {
+                    if (line.starts_with (trigraph.first)) {
+                        line.remove_prefix (trigraph.first.length ());
+
+                        if (this->parameters.ignore_all_syntactic_tokens) {
+                            this->current.location.column += trigraph.first.length ();
+                        } else {
+                            this->append_token (trigraph.second);
+                        }
+                        goto next;
+                    }
+                }
+            }
+
+            if (this->parameters.ignore_all_syntactic_tokens) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_all_parentheses && ((line [0] == L'(') || (line [0] == L')'))) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_all_brackets && ((line [0] == L'[') || (line [0] == L']'))) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_all_braces && ((line [0] == L'{') || (line [0] == L'}'))) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_all_commas && (line [0] == L',')) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_all_semicolons && (line [0] == L';')) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_trailing_commas && (line [0] == L',') && (line.length () == 1)) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+            if (this->parameters.ignore_trailing_semicolons && (line [0] == L';') && (line.length () == 1)) {
+                ++this->current.location.column;
+                line.remove_prefix (1);
+                goto next;
+            }
+
+            this->append_token (line [0]);
+            line.remove_prefix (1);
+        }
+    }
+
+    // string or comment continues on next line
+
+    if (this->current.mode != token::type::code) {
+        this->append_plaintext (source.substr (this->current.plaintext), { this->current.location.row, this->current.plaintext });
+        this->append_plaintext (L" ", { this->current.location.row, (std::uint32_t) source.length () });
+    }
+
+    this->current.location.row++;
+    this->current.location.column = 0;
+
+    if (this->single_line_comment) {
+        --this->single_line_comment;
+        if (this->single_line_comment == 0) {
+            this->close_plaintext ();
+            this->current.mode = token::type::code;
+        }
+    }
+}
+
+template <typename Config>
+typename basic_agsearch <Config>::unit_string basic_agsearch <Config>::narrow (std::wstring_view value) {
+    if constexpr (sizeof (wchar_t) == sizeof (code_unit)) {
+        return unit_string (value.cbegin (), value.cend ());
+    } else {
+        unit_string result;
+        result.reserve (value.length ());
+
+        for (auto c : value) {
+            if (c > 0xFFFF) {
+                result.push_back ((code_unit) (0xD800 + ((c - 0x10000) >> 10)));
+                result.push_back ((code_unit) (0xDC00 + ((c - 0x10000) & 0x3FF)));
+            } else {
+                result.push_back ((code_unit) c);
+            }
+        }
+        return result;
+    }
+}
+
+template <typename Config>
+typename basic_agsearch <Config>::wide_text basic_agsearch <Config>::widen (unit_view value) {
+    if constexpr (std::is_same_v <code_unit, wchar_t>) {
+        return value;
+    } else {
+        std::wstring result;
+        widen (value, result);
+        return result;
+    }
+}
+
+template <typename Config>
+std::wstring_view basic_agsearch <Config>::widen (unit_view value, std::wstring & buffer) {
+    if constexpr (std::is_same_v <code_unit, wchar_t>) {
+        return value;
+    } else {
+        buffer.clear ();
+        for (std::size_t i = 0; i != value.length (); ++i) {
+            wchar_t c = value [i];
+            if constexpr (sizeof (wchar_t) > sizeof (code_unit)) {
+                if ((c >= 0xD800) && (c < 0xDC00) && (i + 1 != value.length ()) && (value [i + 1] >= 0xDC00) && (value [i + 1] < 0xE000)) {
+                    c = (wchar_t) (0x10000 + ((c - 0xD800) << 10) + (value [++i] - 0xDC00));
+                }
+            }
+            buffer.push_back (c);
+        }
+        return buffer;
+    }
+}
+
+template <typename Config>
+std::wstring basic_agsearch <Config>::fold (std::wstring_view value) {
+    bool fold = false;
+    switch (this->current.mode) {
+        case token::type::string: fold = this->parameters.fold_and_ignore_diacritics_strings; break;
+        case token::type::comment: fold = this->parameters.fold_and_ignore_diacritics_comments; break;
+
+        case token::type::code:
+        case token::type::identifier: fold = this->parameters.fold_and_ignore_diacritics_identifiers; break;
+    }
+    if (fold) {
+        auto flags = MAP_COMPOSITE | MAP_EXPAND_LIGATURES | MAP_FOLDCZONE | MAP_FOLDDIGITS;
+        if (auto n = FoldStringW (flags, value.data (), (int) value.size (), NULL, 0)) {
+            std::wstring folded;
+            folded.resize (n);
+            n = FoldStringW (flags, value.data (), (int) value.size (), folded.data (), (int) folded.size ());
+            folded.resize (n);
+
+            return folded;
+        }
+    }
+    return std::wstring (value);
+}
+
+template <typename Config>
+std::wstring basic_agsearch <Config>::make_form (std::wstring_view value) const {
+    return this->simplify (value, true, true);
+}
+
+template <typename Config>
+std::wstring basic_agsearch <Config>::simplify (std::wstring_view value, bool lowercase, bool undiacritic) const {
+    if (std::all_of (value.begin (), value.end (), [] (wchar_t c) { return c < 0x80; })) {
+        std::wstring result (value);
+        if (lowercase) {
+            for (auto & c : result) {
+                if (c >= L'A' && c <= L'Z') {
+                    c += L'a' - L'A';
+                }
+            }
+        }
+        return result;
+    }
+
+    std::wstring result;
+    result.reserve (value.length ());
+
+    // decompose and drop nonspacing characters (diacritics)
+
+    if (undiacritic) {
+        if (auto n = FoldStringW (MAP_COMPOSITE, value.data (), (int) value.size (), NULL, 0)) {
+            std::wstring decomposed;
+            decomposed.resize (n);
+            decomposed.resize (FoldStringW (MAP_COMPOSITE, value.data (), (int) value.size (), decomposed.data (), n));
+
+            std::vector <WORD> types (decomposed.size ());
+            if (GetStringTypeW (CT_CTYPE3, decomposed.data (), (int) decomposed.size (), types.data ())) {
+                for (std::size_t i = 0; i != decomposed.size (); ++i) {
+                    if (!(types [i] & C3_NONSPACING)) {
+                        result.push_back (decomposed [i]);
+                    }
+                }
+            } else {
+                result = decomposed;
+            }
+        }
+    } else {
+        result = value;
+    }
+
+    if (lowercase && !result.empty ()) {
+        std::wstring lowercased;
+        lowercased.resize (result.size ());
+        lowercased.resize (LCMapStringEx (LOCALE_NAME_INVARIANT, LCMAP_LOWERCASE,
+                                          result.data (), (int) result.size (),
+                                          lowercased.data (), (int) lowercased.size (),
+                                          NULL, NULL, 0));
+        result = std::move (lowercased);
+    }
+    return result;
+}
+
+template <typename Config>
+typename basic_agsearch <Config>::unit_string basic_agsearch <Config>::canonical_form (const vocabulary_set::entry & entry, enum token::type type) const {
+    const auto base = widen (entry.alternative.empty () ? entry.value : entry.alternative);
+
+    switch (type) {
+        case token::type::numeric:
+            return narrow (this->simplify (base, this->parameters.case_insensitive_numbers, false));
+        case token::type::string:
+            return narrow (this->simplify (base, this->parameters.case_insensitive_strings, this->parameters.fold_and_ignore_diacritics_strings));
+        case token::type::comment:
+            return narrow (this->simplify (base, this->parameters.case_insensitive_comments, this->parameters.fold_and_ignore_diacritics_comments));
+        case token::type::identifier:
+            return narrow (this->simplify (base, this->parameters.case_insensitive_identifiers, this->parameters.fold_and_ignore_diacritics_identifiers));
+    }
+    return entry.value;
+}
+
+template <typename Config>
+std::uint32_t basic_agsearch <Config>::canonicalize (const token & t) {
+    const auto & entry = std::as_const (this->vocabulary.entries) [t.key];
+    auto key = entry.canonical [(std::size_t) t.type];
+
+    // entries and canonical forms shared with snapshot are copied only here, once for each new token and type
+
+    if (key == vocabulary_set::no_key) {
+        auto & canonicals = *this->vocabulary.canonicals;
+        auto [i, inserted] = canonicals.insert ({ this->canonical_form (entry, t.type), (std::uint32_t) canonicals.size () });
+        key = i->second;
+        this->vocabulary.entries [t.key].canonical [(std::size_t) t.type] = key;
+    }
+    return key;
+}
+
+template <typename Config>
+std::wstring basic_agsearch <Config>::camel_case (std::wstring_view value) {
+    std::wstring alternative;
+
+    // is eligible for camelcasing
+    //  - if, ignoring prefix and suffix underscores, contains sole underscores between words
+
+    auto leading = value.find_first_not_of (L'_');
+    if (leading != std::wstring::npos) {
+
+        std::wstring_view sv (value);
+        sv.remove_prefix (leading);
+
+        auto trailing = sv.length () - (sv.find_last_not_of (L'_') + 1);
+        sv.remove_suffix (trailing);
+
+        // count underscores followed by letter
+
+        std::size_t underscores = 0;
+        for (std::size_t i = 0; i != sv.length () - 1; ++i) {
+            if ((sv [i] == L'_') && std::iswalpha (sv [i + 1]))
+                ++underscores;
+        }
+
+        // eligible, create alternative version
+
+        if (underscores) {
+            alternative.reserve (value.length () - underscores);
+            alternative.append (leading, L'_');
+
+            for (std::size_t i = 0; i < sv.length (); ++i) {
+                if ((sv [i] == L'_') && (i + 1 < sv.length ()) && std::iswalpha (sv [i + 1])) {
+                    alternative.append (1, std::towupper (sv [i + 1]));
+                    ++i;
+                } else {
+                    alternative.append (1, sv [i]);
+                }
+            }
+
+            alternative.append (trailing, L'_');
+        }
+    }
+    return alternative;
+}
 
-                                // remove the token with the letter
+namespace {
+    template <typename C>
+    inline std::uint64_t trigram (const C * p) {
+        return ((std::uint64_t) (p [0] & 0x1F'FFFF) << 42)
+             | ((std::uint64_t) (p [1] & 0x1F'FFFF) << 21)
+             | ((std::uint64_t) (p [2] & 0x1F'FFFF) << 0);
+    }
+}
 
-                                this->pattern.erase (get_preceeding_iterator (this->pattern.end ()));
-                            }
-                        }
-                        goto next;
-                    }
-                    break;
+template <typename Config>
+std::uint32_t basic_agsearch <Config>::intern (std::wstring_view value) {
+    const auto & index = *std::as_const (this->vocabulary.index);
+    auto stored = narrow (value);
+    auto existing = index.find (stored);
+    if (existing != index.end ())
+        return existing->second;
 
-                case token::type::comment:
-                    if (line.starts_with (L"*/") && !this->single_line_comment) {
-                        line.remove_prefix (2);
-                        this->current.location.column += 2;
-                        this->current.mode = token::type::code;
+    auto key = (std::uint32_t) this->vocabulary.entries.size ();
+    this->vocabulary.entries.push_back ({});
+    auto & entry = this->vocabulary.entries.back ();
 
-                        goto next;
-                    }
-                    if (this->parameters.undecorate_comments) {
-                        if (line.starts_with (L'*') || line.starts_with (L'/')) {
-                            line.remove_prefix (1);
-                            this->current.location.column += 1;
-                            goto next;
-                        }
-                    }
-                    break;
+    entry.value = std::move (stored);
+    entry.form = narrow (this->make_form (value));
 
-                case token::type::string:
-                    if (line.starts_with (L"\\\"")) {
-                        line.remove_prefix (2);
-                        this->append_token (L"\"", 2);
+    if (this->parameters.match_snake_and_camel_casing) {
+        const auto alternative = this->camel_case (value);
+        if (!alternative.empty ()) {
+            entry.alternative = narrow (alternative);
+            entry.alternative_form = narrow (this->make_form (alternative));
+        }
+    }
 
-                        goto next;
-                    }
-                    if (line.starts_with (L'"')) {
-                        line.remove_prefix (1);
-                        this->current.location.column += 1;
-                        this->current.mode = token::type::code;
-                        this->current.string_type = 0;
+    entry.subwords = this->split_subwords (value);
 
-                        goto next;
-                    }
-                    break;
+    // index trigrams
+    //  - entries are added in increasing key order, so postings stay sorted
+
+    auto & trigrams = *this->vocabulary.trigrams;
+    for (const auto * form : { &entry.form, &entry.alternative_form }) {
+        for (std::size_t i = 0; i + 2 < form->length (); ++i) {
+            auto & postings = trigrams [trigram (form->data () + i)];
+            if (postings.empty () || (postings.back () != key)) {
+                postings.push_back (key);
             }
+        }
+    }
 
-            for (auto & mct : multi_character_tokens) {
-                if (line.starts_with (mct)) {
-                    line.remove_prefix (mct.length ());
+    this->vocabulary.index->insert ({ entry.value, key });
+    return key;
+}
 
-                    if (parameters.ignore_all_syntactic_tokens) {
-                        this->current.location.column += mct.length ();
-                    } else {
-                        this->append_token (mct, mct.length ());
-                    }
-                    goto next;
-                }
-            }
+template <typename Config>
+std::vector <bool> basic_agsearch <Config>::resolve (const vocabulary_set::entry & word) const {
+    if (word.form.empty ())
+        return {};
 
-            if (this->parameters.digraphs) {
-                for (auto & digraph : alternative_tokens) {
-                    if (line.starts_with (digraph.first)) {
-                        line.remove_prefix (digraph.first.length ());
+    std::vector <bool> candidates (this->vocabulary.entries.size ());
 
-                        if (parameters.ignore_all_syntactic_tokens) {
-                            this->current.location.column += digraph.first.length ();
-                        } else {
-                            this->append_token (digraph.second);
-                        }
-                        goto next;
+    auto contains = [] (const vocabulary_set::entry & entry, const unit_string & form) {
+        return (entry.form.find (form) != unit_string::npos)
+            || (entry.alternative_form.find (form) != unit_string::npos);
+    };
+
+    for (const auto * form : { &word.form, &word.alternative_form }) {
+        if (form->empty ())
+            continue;
+
+        if (form->length () >= 3) {
+
+            // verify only entries listed under the rarest trigram of the word
+
+            const std::vector <std::uint32_t> * rarest = nullptr;
+            for (std::size_t i = 0; i + 2 < form->length (); ++i) {
+                auto postings = this->vocabulary.trigrams->find (trigram (form->data () + i));
+                if (postings == this->vocabulary.trigrams->end ()) {
+                    rarest = nullptr;
+                    break;
+                }
+                if (!rarest || (postings->second.size () < rarest->size ())) {
+                    rarest = &postings->second;
+                }
+            }
+            if (rarest) {
+                for (auto key : *rarest) {
+                    if (contains (this->vocabulary.entries [key], *form)) {
+                        candidates [key] = true;
                     }
                 }
             }
+        } else {
 
-            if (this->parameters.trigraphs) {
-                for (auto & trigraph : trigraph_tokens) {
-                    if (line.starts_with (trigraph.first)) {
-                        line.remove_prefix (trigraph.first.length ());
+            // too short to have trigrams, check all distinct words
 
-                        if (parameters.ignore_all_syntactic_tokens) {
-                            this->current.location.column += trigraph.first.length ();
-                        } else {
-                            this->append_token (trigraph.second);
-                        }
-                        goto next;
-                    }
+            for (std::size_t key = 0; key != this->vocabulary.entries.size (); ++key) {
+                if (contains (this->vocabulary.entries [key], *form)) {
+                    candidates [key] = true;
                 }
             }
+        }
+    }
+    return candidates;
+}
 
-            if (parameters.ignore_all_syntactic_tokens) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
-            }
-            if (parameters.ignore_all_parentheses && ((line [0] == L'(') || (line [0] == L')'))) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
-            }
-            if (parameters.ignore_all_brackets && ((line [0] == L'[') || (line [0] == L']'))) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
+template <typename Config>
+std::vector <typename basic_agsearch <Config>::vocabulary_set::subword> basic_agsearch <Config>::split_subwords (std::wstring_view value) {
+    std::vector <typename vocabulary_set::subword> subwords;
+
+    // words are separated by non-alphanumeric characters (underscores) and by case changes
+    //  - run of uppercase letters followed by lowercase is acronym followed by word: HTTPResponse -> HTTP, Response
+    //  - digits stick to preceding word
+
+    std::size_t i = 0;
+    while (i < value.length ()) {
+        if (!std::iswalnum (value [i])) {
+            ++i;
+            continue;
+        }
+
+        auto lower = [&value] (std::size_t e) {
+            return (e < value.length ()) && std::iswalnum (value [e]) && !std::iswupper (value [e]);
+        };
+
+        auto e = i + 1;
+        if (std::iswupper (value [i])) {
+            while ((e < value.length ()) && std::iswupper (value [e])) {
+                ++e;
             }
-            if (parameters.ignore_all_braces && ((line [0] == L'{') || (line [0] == L'}'))) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
+            if (e - i == 1) {
+                while (lower (e)) {
+                    ++e;
+                }
+            } else
+            if (lower (e) && !std::iswdigit (value [e])) {
+                --e;
+            } else {
+                while ((e < value.length ()) && std::iswdigit (value [e])) {
+                    ++e;
+                }
             }
-            if (parameters.ignore_all_commas && (line [0] == L',')) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
+        } else {
+            while (lower (e)) {
+                ++e;
             }
-            if (parameters.ignore_all_semicolons && (line [0] == L';')) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
+        }
+
+        typename vocabulary_set::subword sw;
+        sw.form = narrow (this->make_form (value.substr (i, e - i)));
+        sw.offset = (std::uint32_t) i;
+        sw.length = (std::uint32_t) (e - i);
+
+        // the map shared with snapshot is copied only when new subword is added
+
+        const auto & known = *std::as_const (this->vocabulary.subwords);
+        if (auto it = known.find (sw.form); it != known.end ()) {
+            sw.id = it->second;
+        } else {
+            sw.id = (std::uint32_t) this->vocabulary.postings.size ();
+            this->vocabulary.subwords->insert ({ sw.form, sw.id });
+            this->vocabulary.postings.push_back ({});
+        }
+
+        subwords.push_back (std::move (sw));
+        i = e;
+    }
+    return subwords;
+}
+
+template <typename Config>
+bool basic_agsearch <Config>::may_contain (std::size_t block, std::uint32_t key) const {
+    const auto words = vocabulary_set::block_bits / 64;
+    for (auto bit : bloom_bits (key)) {
+        if (!(this->vocabulary.blocks [block * words + bit / 64] & (1uLL << (bit % 64))))
+            return false;
+    }
+    return true;
+}
+
+template <typename Config>
+std::vector <std::uint32_t> basic_agsearch <Config>::postings (const vocabulary_set::entry & word) const {
+    std::vector <std::uint32_t> positions;
+
+    // the only subword may be partial, otherwise the first one is whole
+
+    const auto & prefix = word.subwords.front ().form;
+    if (word.subwords.size () == 1) {
+        for (auto i = this->vocabulary.subwords->lower_bound (prefix); (i != this->vocabulary.subwords->end ()) && i->first.starts_with (prefix); ++i) {
+            const auto & list = *this->vocabulary.postings [i->second];
+            positions.insert (positions.end (), list.begin (), list.end ());
+        }
+        std::sort (positions.begin (), positions.end ());
+        positions.erase (std::unique (positions.begin (), positions.end ()), positions.end ());
+    } else {
+        auto i = this->vocabulary.subwords->find (prefix);
+        if (i != this->vocabulary.subwords->end ()) {
+            positions = *this->vocabulary.postings [i->second];
+        }
+    }
+    return positions;
+}
+
+template <typename Config>
+void basic_agsearch <Config>::remove_last_token () {
+    auto position = (std::uint32_t) (this->pattern.size () - 1);
+    for (auto line = this->lines.size (); line && (position < std::as_const (this->lines) [line - 1].tokens); --line) {
+        this->lines [line - 1].joined = true;
+    }
+    if (position < this->vocabulary.indexed) {
+        for (const auto & sw : std::as_const (this->vocabulary.entries) [this->pattern.back ().key].subwords) {
+            auto & list = *this->vocabulary.postings [sw.id];
+            if (!list.empty () && (list.back () == position)) {
+                list.pop_back ();
             }
-            if (parameters.ignore_trailing_commas && (line [0] == L',') && (line.length () == 1)) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
+        }
+        auto & kind = this->vocabulary.kinds [(std::size_t) this->pattern.back ().type];
+        if (!kind.empty () && (kind.back () == position)) {
+            kind.pop_back ();
+        }
+        while (!this->vocabulary.rows.empty () && (this->vocabulary.rows.back () == position)) {
+            this->vocabulary.rows.pop_back ();
+        }
+        if (this->pattern.back ().type == token::type::numeric) {
+            const auto & numbers = *std::as_const (this->vocabulary.numbers);
+            auto i = std::lower_bound (numbers.cbegin (), numbers.cend (), std::make_pair (numeric_value (this->pattern.back ()), position));
+            if ((i != numbers.cend ()) && (i->second == position)) {
+                const auto n = i - numbers.cbegin ();
+                this->vocabulary.numbers->erase (this->vocabulary.numbers->cbegin () + n);
             }
-            if (parameters.ignore_trailing_semicolons && (line [0] == L';') && (line.length () == 1)) {
-                ++this->current.location.column;
-                line.remove_prefix (1);
-                goto next;
+        }
+        if (this->bracket_value (this->pattern.back ())) {
+            this->unindex_brackets (position);
+        }
+        this->vocabulary.indexed = position;
+    }
+    this->pattern.pop_back ();
+}
+
+template <typename Config>
+void basic_agsearch <Config>::append_token (std::wstring_view value, std::size_t advance) {
+    token t;
+    t.location = this->current.location;
+    t.type = this->current.mode;
+    t.key = this->intern (value);
+    t.length = (std::uint32_t) advance;
+
+    if (this->current.mode == token::type::string) {
+        t.string_type = this->current.string_type;
+    }
+
+    this->pattern.push_back (t);
+    this->current.location.column += (std::uint32_t) advance;
+
+    if (value == L"?") {
+        this->current.conditionals++;
+    } else
+    if ((value == L":") && this->current.conditionals) {
+        this->current.conditionals--;
+    }
+}
+
+template <typename Config>
+void basic_agsearch <Config>::append_identifier (std::wstring_view value, std::size_t advance) {
+    token t;
+    t.location = this->current.location;
+
+    if (this->current.mode == token::type::code) {
+        t.type = token::type::identifier;
+    } else {
+        t.type = this->current.mode;
+    }
+    if (this->current.mode == token::type::string) {
+        t.string_type = this->current.string_type;
+    }
+
+    t.key = this->intern (this->fold (value));
+    t.length = (std::uint32_t) advance;
+
+    this->pattern.push_back (t);
+    this->current.location.column += (std::uint32_t) advance;
+}
+
+template <typename Config>
+void basic_agsearch <Config>::append_numeric (std::wstring_view value, std::uint64_t i, double * d, std::size_t advance) {
+    token t;
+    t.location = this->current.location;
+
+    if (this->current.mode == token::type::code) {
+        t.type = token::type::numeric;
+    } else {
+        t.type = this->current.mode;
+    }
+    if (this->current.mode == token::type::string) {
+        t.string_type = this->current.string_type;
+    }
+    t.key = this->intern (value);
+    t.length = (std::uint32_t) advance;
+    t.integer = i;
+
+    if (d) {
+        t.decimal = *d;
+        t.is_decimal = true;
+    }
+
+    this->pattern.push_back (t);
+    this->current.location.column += (std::uint32_t) advance;
+}
+
+template <typename Config>
+void basic_agsearch <Config>::append_token (wchar_t c) {
+    return this->append_token (std::wstring_view (&c, 1), 1);
+}
+
+template <typename Config>
+void basic_agsearch <Config>::open_plaintext () {
+    this->current.plaintext = this->current.location.column;
+    this->plaintext.segments.push_back ({ (std::uint32_t) this->plaintext.text.size (), this->current.mode });
+}
+
+template <typename Config>
+void basic_agsearch <Config>::append_plaintext (std::wstring_view text, location at) {
+    auto & pt = this->plaintext;
+    const auto decorations = (this->current.mode == token::type::comment) && this->parameters.undecorate_comments;
+    const auto accelerators = (this->current.mode == token::type::string) && this->parameters.ignore_accelerator_hints_in_strings;
+
+    for (std::size_t i = 0; i != text.length (); ++i, ++at.column) {
+        auto c = text [i];
+
+        if ((whitespace.find (c) != std::wstring_view::npos) || (decorations && (c == L'*' || c == L'/'))) {
+            if (pt.text.empty () || (pt.text.back () == L' ') || (pt.text.back () == L'\0') || (pt.text.size () == pt.segments.back ().offset))
+                continue;
+
+            c = L' ';
+        }
+        if (accelerators && (c == L'&')) {
+            if ((i + 1 == text.length ()) || (text [i + 1] != L'&'))
+                continue;
+
+            ++i; // '&&' is literal '&'
+            ++at.column;
+        }
+
+        // new piece whenever characters stop being contiguous
+
+        if (pt.pieces.empty ()
+                || (pt.pieces.back ().location.row != at.row)
+                || (pt.pieces.back ().location.column + (pt.text.size () - pt.pieces.back ().offset) != at.column)) {
+            pt.pieces.push_back ({ (std::uint32_t) pt.text.size (), at });
+        }
+
+        // character outside BMP is stored as surrogate pair, the low surrogate in piece of its own at the same column
+
+        if constexpr (sizeof (wchar_t) > sizeof (code_unit)) {
+            if (c > 0xFFFF) {
+                pt.text.push_back ((code_unit) (0xD800 + ((c - 0x10000) >> 10)));
+                pt.pieces.push_back ({ (std::uint32_t) pt.text.size (), at });
+                c = (wchar_t) (0xDC00 + ((c - 0x10000) & 0x3FF));
             }
+        }
+        pt.text.push_back ((code_unit) c);
+    }
+}
 
-            this->append_token (line [0]);
-            line.remove_prefix (1);
+template <typename Config>
+void basic_agsearch <Config>::close_plaintext () {
+    auto & pt = this->plaintext;
+    if (pt.segments.empty ())
+        return;
+
+    if (pt.text.size () == pt.segments.back ().offset) {
+        pt.segments.pop_back (); // empty string or comment
+    } else
+    if (pt.text.back () == L' ') {
+        pt.text.back () = L'\0';
+        if (pt.folded.size () + pt.underscores.size () == pt.text.size ()) {
+            pt.folded.back () = L'\0';
         }
+    } else {
+        pt.text.push_back (L'\0');
     }
+}
 
-    this->current.location.row++;
-    this->current.location.column = 0;
+template <typename Config>
+void basic_agsearch <Config>::fold_plaintext () {
+    auto & pt = this->plaintext;
+    auto offset = pt.folded.size () + pt.underscores.size (); // in 'text', folded so far
 
-    if (this->single_line_comment) {
-        --this->single_line_comment;
-        if (this->single_line_comment == 0) {
-            this->current.mode = token::type::code;
+    auto segment = std::upper_bound (pt.segments.cbegin (), pt.segments.cend (), (std::uint32_t) offset,
+                                     [] (std::uint32_t offset, const plaintext_set::segment & s) { return offset < s.offset; });
+
+    while (offset < pt.text.size ()) {
+        if (segment == pt.segments.cbegin ()) {
+            pt.folded.push_back (pt.text [offset++]);
+            continue;
+        }
+
+        const auto type = std::prev (segment)->type;
+        const auto end = (segment != pt.segments.cend ()) ? std::min ((std::size_t) segment->offset, pt.text.size ()) : pt.text.size ();
+
+        const auto lowercase = (type == token::type::string) ? this->parameters.case_insensitive_strings
+                                                             : this->parameters.case_insensitive_comments;
+        const auto undiacritic = (type == token::type::string) ? this->parameters.fold_and_ignore_diacritics_strings
+                                                               : this->parameters.fold_and_ignore_diacritics_comments;
+
+        // each character folds to single character to keep offsets in 'pieces' valid
+
+        while (offset < end) {
+            auto c = pt.text [offset];
+            if ((c == L'_') && this->parameters.match_snake_and_camel_casing) {
+                pt.underscores.push_back ((std::uint32_t) offset++);
+                continue;
+            }
+            if (c < 0x80) {
+                if (lowercase && (c >= L'A' && c <= L'Z')) {
+                    c += L'a' - L'A';
+                }
+            } else
+            if (lowercase || undiacritic) {
+                const wchar_t w = c;
+                auto simple = narrow (this->simplify (std::wstring_view (&w, 1), lowercase, undiacritic));
+                if (simple.length () == 1) {
+                    c = simple [0];
+                }
+            }
+            pt.folded.push_back (c);
+            ++offset;
+        }
+        if (segment != pt.segments.cend ()) {
+            ++segment;
         }
     }
 }
 
-std::wstring agsearch::fold (std::wstring_view value) {
-    bool fold = false;
-    switch (this->current.mode) {
-        case token::type::string: fold = parameters.fold_and_ignore_diacritics_strings; break;
-        case token::type::comment: fold = parameters.fold_and_ignore_diacritics_comments; break;
+template <typename Config>
+typename basic_agsearch <Config>::location basic_agsearch <Config>::locate_plaintext (std::size_t offset) const {
+    auto piece = std::upper_bound (this->plaintext.pieces.cbegin (), this->plaintext.pieces.cend (), (std::uint32_t) offset,
+                                   [] (std::uint32_t offset, const plaintext_set::piece & p) { return offset < p.offset; });
+    --piece;
+    return { piece->location.row, piece->location.column + (std::uint32_t) (offset - piece->offset) };
+}
 
-        case token::type::code:
-        case token::type::identifier: fold = parameters.fold_and_ignore_diacritics_identifiers; break;
-    }
-    if (fold) {
-        auto flags = MAP_COMPOSITE | MAP_EXPAND_LIGATURES | MAP_FOLDCZONE | MAP_FOLDDIGITS;
-        if (auto n = FoldStringW (flags, value.data (), (int) value.size (), NULL, 0)) {
-            std::wstring folded;
-            folded.resize (n);
-            n = FoldStringW (flags, value.data (), (int) value.size (), folded.data (), (int) folded.size ());
-            folded.resize (n);
+template <typename Config>
+typename basic_agsearch <Config>::unit_view basic_agsearch <Config>::plaintext_needle (const basic_agsearch & needle) {
+    const auto & folded = needle.plaintext.folded;
 
-            return folded;
-        }
+    // folded text of the needle without terminating L'\0', empty if it doesn't fit single segment and isn't contiguous
+
+    if (folded.empty () || (folded.size () > folded.segment_size))
+        return {};
+
+    unit_view text (&folded [0], folded.size ());
+    if (text.ends_with (code_unit (L'\0'))) {
+        text.remove_suffix (1);
     }
-    return std::wstring (value);
+    return text;
 }
 
-void agsearch::append_token (std::wstring_view value, std::size_t advance) {
-    token t;
-    t.location = this->current.location;
-    t.type = this->current.mode;
-    t.value = value;
-    t.length = (std::uint32_t) advance;
+template <typename Config>
+bool basic_agsearch <Config>::next_plaintext (query & q, match & m, std::size_t limit) const {
+    const auto & needle = *q.needle;
 
-    if (this->current.mode == token::type::string) {
-        t.string_type = this->current.string_type;
-    }
+    const auto text = basic_agsearch::plaintext_needle (needle);
+    const auto type = needle.plaintext.segments.front ().type;
+    const auto & folded = this->plaintext.folded;
+    const auto & underscores = this->plaintext.underscores;
+    const auto size = this->plaintext.text.size ();
 
-    this->pattern.push_back (t);
-    this->current.location.column += (std::uint32_t) advance;
-}
+    auto is_word_character = [] (wchar_t c) { return std::iswalnum (c) || c == L'_'; };
 
-void agsearch::append_identifier (std::wstring_view value, std::size_t advance) {
-    token t;
-    t.location = this->current.location;
+    // 'q.position' is offset in 'text', which differs from index into 'folded' by number of underscores before it
 
-    if (this->current.mode == token::type::code) {
-        t.type = token::type::identifier;
-    } else {
-        t.type = this->current.mode;
-    }
-    if (this->current.mode == token::type::string) {
-        t.string_type = this->current.string_type;
-    }
+    const auto fold = [&underscores] (std::size_t offset) {
+        return offset - (std::lower_bound (underscores.cbegin (), underscores.cend (), (std::uint32_t) offset) - underscores.cbegin ());
+    };
+    const auto unfold = [&underscores] (std::size_t index) {
+        std::size_t lo = 0;
+        std::size_t hi = underscores.size ();
+        while (lo < hi) {
+            const auto mid = (lo + hi) / 2;
+            if (underscores [mid] - mid <= index) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return index + lo;
+    };
 
-    t.value = this->fold (value);
-    t.length = (std::uint32_t) advance;
+    // no match may start at or after 'limit' characters from current position in this call
 
-    this->pattern.push_back (t);
-    this->current.location.column += (std::uint32_t) advance;
-}
+    const auto from = std::min (q.position, size);
+    const auto stop = (size - from > limit) ? from + limit : size;
+    const auto last = folded.cbegin () + ((stop == size) ? folded.size () : std::min (folded.size (), fold (stop) + text.length () - 1));
 
-void agsearch::append_numeric (std::wstring_view value, std::uint64_t i, double * d, std::size_t advance) {
-    token t;
-    t.location = this->current.location;
+    for (auto i = folded.cbegin () + fold (from); (i = std::search (i, last, *q.searcher)) != last; ++i) {
+        const auto index = (std::size_t) (i - folded.cbegin ());
+        const auto offset = unfold (index);
+        const auto end = index + text.length ();
 
-    if (this->current.mode == token::type::code) {
-        t.type = token::type::numeric;
-    } else {
-        t.type = this->current.mode;
-    }
-    if (this->current.mode == token::type::string) {
-        t.string_type = this->current.string_type;
-    }
-    t.value = value;
-    t.length = (std::uint32_t) advance;
-    t.integer = i;
+        // strings match strings only, comments match comments only
 
-    if (d) {
-        t.decimal = *d;
-        t.is_decimal = true;
-    }
+        auto segment = std::upper_bound (this->plaintext.segments.cbegin (), this->plaintext.segments.cend (), (std::uint32_t) offset,
+                                         [] (std::uint32_t offset, const typename plaintext_set::segment & s) { return offset < s.offset; });
+        if ((segment == this->plaintext.segments.cbegin ()) || (std::prev (segment)->type != type))
+            continue;
 
-    this->pattern.push_back (t);
-    this->current.location.column += (std::uint32_t) advance;
-}
+        if (this->parameters.whole_words) {
+            if ((offset > 0) && is_word_character (this->plaintext.text [offset - 1]) && is_word_character (text.front ()))
+                continue;
+            if ((unfold (end - 1) + 1 < size) && is_word_character (this->plaintext.text [unfold (end - 1) + 1]) && is_word_character (text.back ()))
+                continue;
+        }
 
-void agsearch::append_token (wchar_t c) {
-    return this->append_token (std::wstring_view (&c, 1), 1);
+        m.begin = this->locate_plaintext (offset);
+        m.end = this->locate_plaintext (unfold (end - 1));
+        m.end.column += 1;
+
+        // instances don't overlap, as in 'pattern'
+
+        q.position = unfold (end);
+        return true;
+    }
+    if (stop == size) {
+        q.done = true;
+    } else {
+        q.position = stop;
+    }
+    return false;
 }
 
-void agsearch::normalize_needle () {
+template <typename Config>
+void basic_agsearch <Config>::normalize_needle (std::size_t from) {
+    this->merge_specifiers (from);
+
+    const auto begin = this->pattern.begin () + from;
+    const auto end = this->pattern.end ();
 
     // detect which ':' can be converted into else
 
     if (this->parameters.match_ifs_and_conditional) {
         auto n = 0u;
-        for (auto & token : this->pattern) {
-            if (token.value == L"?") {
+        if ((begin != end) && (begin->location.row < this->lines.size ())) {
+            n = this->lines [begin->location.row].lexer.conditionals; // unpaired in previously normalized lines
+        }
+        for (auto token = begin; token != end; ++token) {
+            if (equals (this->stored (*token), L"?")) {
                 ++n;
             } else
-            if (n && (token.value == L":")) {
-                token.opt_alt_spelling_allowed = true;
+            if (n && equals (this->stored (*token), L":")) {
+                token->opt_alt_spelling_allowed = true;
                 --n;
             }
         }
@@ -1141,83 +3291,112 @@ void agsearch::normalize_needle () {
     //  - removes sole '&' inside strings; NOTE that string are tokenized too, so it may not always work
 
     if (this->parameters.ignore_accelerator_hints_in_strings) {
-        for (auto & token : this->pattern) {
-            if (token.type == token::type::string) {
+        for (auto token = begin; token != end; ++token) {
+            if ((token->type == token::type::string) && (this->stored (*token).find (code_unit (L'&')) != unit_string::npos)) {
 
+                std::wstring value (this->text (*token));
                 auto i = std::wstring::npos;
-                while ((i = token.value.find (L'&', i + 1)) != std::wstring::npos) {
+                while ((i = value.find (L'&', i + 1)) != std::wstring::npos) {
 
-                    if ((i < token.value.length () - 1) && (token.value [i + 1] == L'&')) {
-                        token.value.erase (i, 1);
+                    if ((i < value.length () - 1) && (value [i + 1] == L'&')) {
+                        value.erase (i, 1);
                         ++i;
                     } else {
-                        token.value.erase (i, 1);
+                        value.erase (i, 1);
                     }
                 }
+                token->key = this->intern (value);
             }
         }
     }
 
-    // create alternative "camelCaseIdentifiers" for all "snake_case_identifiers
-
-    if (this->parameters.match_snake_and_camel_casing) {
-        for (auto & token : this->pattern) {
-            switch (token.type) {
-                case token::type::identifier:
-                case token::type::comment:
-                case token::type::string:
-                    
-                    // is eligible for camelcasing
-                    //  - if, ignoring prefix and suffix underscores, contains sole underscores between words
+    // TODO: rewrite casts
+    //  ? xxx_cast < A A A > ( B B B )
+    //  > ( A A A ) B B B
 
-                    auto leading = token.value.find_first_not_of (L'_');
-                    if (leading != std::wstring::npos) {
+}
 
-                        std::wstring_view sv (token.value);
-                        sv.remove_prefix (leading);
+template <typename Config>
+void basic_agsearch <Config>::merge_specifiers (std::size_t from) {
+    if (!this->parameters.match_any_integer_decl_style && !this->parameters.match_any_inheritance_type)
+        return;
 
-                        auto trailing = sv.length () - (sv.find_last_not_of (L'_') + 1);
-                        sv.remove_suffix (trailing);
+    // merge runs of declaration specifiers into single token
+    //  - 'short int unsigned' and 'unsigned short' both become 'unsigned short int' token
+    //  - ': virtual public' becomes ':' with access specifiers, same for ',' between base classes
+    //  - runs do not continue to next line, as the token wouldn't be able to describe its length
 
-                        // count underscores followed by letter
+    auto o = from;
+    auto i = from;
 
-                        std::size_t underscores = 0;
-                        for (std::size_t i = 0; i != sv.length () - 1; ++i) {
-                            if ((sv [i] == L'_') && std::iswalpha (sv [i + 1]))
-                                ++underscores;
-                        }
+    while (i != this->pattern.size ()) {
+        const auto & t = this->pattern [i];
 
-                        // eligible, create alternative version
+        std::uint32_t bits = 0;
+        std::size_t e = i;
 
-                        if (underscores) {
-                            token.alternative.reserve (token.value.length () - underscores);
-                            token.alternative.append (leading, L'_');
+        if (this->parameters.match_any_integer_decl_style && (t.type == token::type::identifier)) {
+            while ((e != this->pattern.size ())
+                    && (this->pattern [e].type == token::type::identifier)
+                    && (this->pattern [e].location.row == t.location.row)) {
 
-                            for (std::size_t i = 0; i < sv.length () - 1; ++i) {
-                                if ((sv [i] == L'_') && std::iswalpha (sv [i + 1])) {
-                                    token.alternative.append (1, std::towupper (sv [i + 1]));
-                                    ++i;
-                                } else {
-                                    token.alternative.append (1, sv [i]);
-                                }
-                            }
+                auto specifier = specifier_bits (integer_specifiers, this->stored (this->pattern [e]));
+                if (specifier && (((bits + specifier) & integer_specifiers_mask) > bits)) { // no overflow
+                    bits += specifier;
+                    ++e;
+                } else
+                    break;
+            }
+        }
+        if (this->parameters.match_any_inheritance_type && (t.type == token::type::code) && (equals (this->stored (t), L":") || equals (this->stored (t), L","))) {
+            e = i + 1;
+            while ((e != this->pattern.size ())
+                    && (this->pattern [e].type == token::type::identifier)
+                    && (this->pattern [e].location.row == t.location.row)) {
+
+                if (auto specifier = specifier_bits (access_specifiers, this->stored (this->pattern [e]))) {
+                    bits |= specifier;
+                    ++e;
+                } else
+                    break;
+            }
+        }
 
-                            token.alternative.append (1, sv.back ());
-                            token.alternative.append (trailing, L'_');
+        if (bits) {
+            token merged = t;
+            merged.specifiers = bits;
+            merged.length = this->pattern [e - 1].location.column + this->pattern [e - 1].length - t.location.column;
+
+            if (bits & integer_specifiers_mask) {
+                std::wstring value;
+                for (const auto & specifier : integer_specifiers) {
+                    for (auto n = (bits / specifier.bits) & 0xF; n; --n) {
+                        if (!value.empty ()) {
+                            value += L' ';
                         }
+                        value += specifier.spelling;
                     }
+                }
+                merged.key = this->intern (value);
+            }
+
+            this->pattern [o++] = std::move (merged);
+            i = e;
+        } else {
+            if (o != i) {
+                this->pattern [o] = std::move (this->pattern [i]);
             }
+            ++o;
+            ++i;
         }
     }
-
-    // TODO: rewrite casts
-    //  ? xxx_cast < A A A > ( B B B )
-    //  > ( A A A ) B B B
-
+    this->pattern.resize (o);
 }
 
-void agsearch::normalize_full () {
-    this->normalize_needle ();
+template <typename Config>
+void basic_agsearch <Config>::normalize_full () {
+    this->normalize_needle (this->vocabulary.indexed);
+    this->index ();
 
     // unescape strings
 
@@ -1275,3 +3454,484 @@ void agsearch::normalize_full () {
         }
     }*/
 }
+
+template <typename Config>
+void basic_agsearch <Config>::index () {
+    const auto row = this->vocabulary.rows.size ();
+    std::vector <std::pair <double, std::uint32_t>> numbers;
+
+    // canonical keys and subword postings for newly appended tokens
+
+    for (auto position = this->vocabulary.indexed; position != this->pattern.size (); ++position) {
+        auto & t = this->pattern [position];
+        t.canonical = this->canonicalize (t);
+        this->vocabulary.kinds [(std::size_t) t.type].push_back ((std::uint32_t) position);
+
+        while (this->vocabulary.rows.size () <= t.location.row) {
+            this->vocabulary.rows.push_back ((std::uint32_t) position);
+        }
+
+        const auto block = position / vocabulary_set::block_size;
+        const auto words = vocabulary_set::block_bits / 64;
+        if (this->vocabulary.blocks.size () < (block + 1) * words) {
+            this->vocabulary.blocks.resize ((block + 1) * words);
+        }
+        for (auto bit : bloom_bits (t.key)) {
+            this->vocabulary.blocks [block * words + bit / 64] |= 1uLL << (bit % 64);
+        }
+
+        if (t.type != token::type::code) {
+            for (const auto & sw : std::as_const (this->vocabulary.entries) [t.key].subwords) {
+                auto & list = *this->vocabulary.postings [sw.id];
+                if (list.empty () || (list.back () != position)) {
+                    list.push_back ((std::uint32_t) position);
+                }
+            }
+        }
+        if (t.type == token::type::numeric) {
+            numbers.push_back ({ numeric_value (t), (std::uint32_t) position });
+        }
+        if (this->bracket_value (t)) {
+            this->index_bracket ((std::uint32_t) position);
+        }
+    }
+
+    // new numbers sorted and merged with those already indexed, which are copied only if shared
+
+    if (!numbers.empty ()) {
+        auto & values = *this->vocabulary.numbers;
+        const auto merged = values.size ();
+
+        std::sort (numbers.begin (), numbers.end ());
+        values.insert (values.end (), numbers.cbegin (), numbers.cend ());
+        std::inplace_merge (values.begin (), values.begin () + merged, values.end ());
+    }
+
+    this->vocabulary.indexed = this->pattern.size ();
+    this->vocabulary.revision++;
+    this->fold_plaintext ();
+
+    // normalization merged some tokens, lines start at positions from 'rows' now
+
+    for (auto r = row; r < this->lines.size (); ++r) {
+        this->lines [r].tokens = (std::uint32_t) ((r < this->vocabulary.rows.size ()) ? this->vocabulary.rows [r] : this->pattern.size ());
+    }
+}
+
+template <typename Config>
+void basic_agsearch <Config>::truncate (std::size_t row) {
+    const auto & line = std::as_const (this->lines) [row];
+    const auto position = line.tokens;
+
+    // tokens and their indexes
+
+    const auto & tokens = std::as_const (this->pattern);
+    for (auto p = position; p < std::min (this->vocabulary.indexed, tokens.size ()); ++p) {
+        const auto & t = tokens [p];
+        if (t.type != token::type::code) {
+            for (const auto & sw : std::as_const (this->vocabulary.entries) [t.key].subwords) {
+                auto & list = *this->vocabulary.postings [sw.id];
+                while (!list.empty () && (list.back () >= position)) {
+                    list.pop_back ();
+                }
+            }
+        }
+    }
+    this->pattern.resize (position);
+    for (auto & kind : this->vocabulary.kinds) {
+        kind.resize (std::lower_bound (kind.cbegin (), kind.cend (), (std::uint32_t) position) - kind.cbegin ());
+    }
+    while (!this->vocabulary.rows.empty () && (std::as_const (this->vocabulary.rows).back () >= position)) {
+        this->vocabulary.rows.pop_back ();
+    }
+
+    const auto & numbers = *std::as_const (this->vocabulary.numbers);
+    const auto removed = [position] (const auto & number) { return number.second >= position; };
+    if (std::any_of (numbers.cbegin (), numbers.cend (), removed)) {
+        std::erase_if (*this->vocabulary.numbers, removed);
+    }
+    this->unindex_brackets (position);
+
+    // Bloom filter bits can't be removed, the last block is rebuilt
+
+    const auto block = position / vocabulary_set::block_size;
+    const auto words = vocabulary_set::block_bits / 64;
+
+    if (this->vocabulary.blocks.size () > block * words) {
+        this->vocabulary.blocks.resize (block * words);
+    }
+    for (auto p = block * vocabulary_set::block_size; p != position; ++p) {
+        if (this->vocabulary.blocks.size () < (block + 1) * words) {
+            this->vocabulary.blocks.resize ((block + 1) * words);
+        }
+        for (auto bit : bloom_bits (tokens [p].key)) {
+            this->vocabulary.blocks [block * words + bit / 64] |= 1uLL << (bit % 64);
+        }
+    }
+    this->vocabulary.indexed = std::min (this->vocabulary.indexed, (std::size_t) position);
+
+    // plain text, closing string or comment on the line might have changed what preceded it
+
+    auto & pt = this->plaintext;
+    pt.text.resize (line.text);
+    if (!pt.text.empty ()) {
+        pt.text.back () = line.last;
+    }
+    const auto kept = (std::uint32_t) (pt.text.empty () ? 0 : pt.text.size () - 1);
+    pt.underscores.resize (std::lower_bound (pt.underscores.cbegin (), pt.underscores.cend (), kept) - pt.underscores.cbegin ());
+    pt.folded.resize (std::min (pt.folded.size (), kept - pt.underscores.size ()));
+    pt.pieces.resize (line.pieces);
+    if (line.segments) {
+        pt.segments.resize (line.segments - 1);
+        pt.segments.push_back (line.segment);
+    } else {
+        pt.segments.clear ();
+    }
+
+    // lexer
+
+    this->current = line.lexer;
+    this->single_line_comment = line.single_line_comment;
+    this->lines.resize (row);
+}
+
+template <typename Config>
+void basic_agsearch <Config>::reload_lines (std::span <const std::wstring_view> text) {
+    const std::hash <std::wstring_view> hash;
+    const auto & lines = std::as_const (this->lines);
+
+    // unchanged lines at the start and at the end
+
+    std::size_t prefix = 0;
+    while ((prefix != text.size ()) && (prefix != lines.size ()) && (hash (text [prefix]) == lines [prefix].hash)) {
+        ++prefix;
+    }
+    if ((prefix == text.size ()) && (prefix == lines.size ()))
+        return;
+
+    // lines after token that was removed later can't be resumed from
+
+    while (prefix && (prefix < lines.size ()) && lines [prefix].joined) {
+        --prefix;
+    }
+
+    std::size_t suffix = 0;
+    while ((prefix + suffix != text.size ()) && (prefix + suffix != lines.size ())
+            && (hash (text [text.size () - suffix - 1]) == lines [lines.size () - suffix - 1].hash)) {
+        ++suffix;
+    }
+
+    // keep what the unchanged end can be spliced from
+    //  - 'pattern' copy shares the segments
+
+    const auto previous = this->pattern;
+    const std::vector <line_state> tail (lines.cend () - suffix, lines.cend ());
+    const auto end = std::make_pair (this->current, this->single_line_comment);
+
+    const auto & pt = this->plaintext;
+    const auto base = suffix ? tail.front ()
+                             : line_state { 0, 0, (std::uint32_t) pt.text.size (), (std::uint32_t) pt.pieces.size (), (std::uint32_t) pt.segments.size (),
+                                           code_unit {}, {}, {}, 0, false };
+
+    const unit_string text_tail (pt.text.cbegin () + base.text, pt.text.cend ());
+    const auto underscore = std::lower_bound (pt.underscores.cbegin (), pt.underscores.cend (), base.text);
+    const std::vector <std::uint32_t> underscores_tail (underscore, pt.underscores.cend ());
+    const unit_string folded_tail (pt.folded.cbegin () + std::min ((std::size_t) base.text - (underscore - pt.underscores.cbegin ()), pt.folded.size ()),
+                                    pt.folded.cend ());
+    const std::vector <typename plaintext_set::piece> pieces_tail (pt.pieces.cbegin () + base.pieces, pt.pieces.cend ());
+    const std::vector <typename plaintext_set::segment> segments_tail (pt.segments.cbegin () + base.segments, pt.segments.cend ());
+
+    if (prefix != lines.size ()) {
+        this->truncate (prefix);
+    }
+
+    // process changed lines, then unchanged ones until the state allows splicing the rest
+
+    const auto first = text.size () - suffix;
+    for (std::size_t i = prefix; i != first; ++i) {
+        this->process_line (text [i]);
+    }
+
+    std::size_t j = 0;
+    for (; j != suffix; ++j) {
+        const auto & line = tail [j];
+        const bool spliceable = (line.lexer.mode == token::type::code) && (this->current.mode == token::type::code)
+                             && !line.single_line_comment && !this->single_line_comment
+                             && (line.lexer.string_type == this->current.string_type)
+                             && (line.lexer.conditionals == this->current.conditionals)
+                             && !line.joined
+                             && (this->pattern.empty ()
+                                 || (std::as_const (this->pattern).back ().type != token::type::identifier)
+                                 || (this->stored (std::as_const (this->pattern).back ()).length () != 1));
+        if (spliceable)
+            break;
+
+        this->process_line (text [first + j]);
+    }
+
+    this->normalize_needle (this->vocabulary.indexed);
+
+    if (j != suffix) {
+        const auto & line = tail [j];
+        const auto rows = (std::uint32_t) (first + j) - line.lexer.location.row;
+        const auto tokens = (std::uint32_t) this->pattern.size () - line.tokens;
+
+        this->fold_plaintext ();
+
+        const auto characters = (std::uint32_t) this->plaintext.text.size () - line.text;
+        const auto pieces = (std::uint32_t) this->plaintext.pieces.size () - line.pieces;
+        const auto segments = (std::uint32_t) this->plaintext.segments.size () - line.segments;
+        const auto last = pt.text.empty () ? code_unit {} : pt.text.back ();
+        const auto segment = pt.segments.empty () ? typename plaintext_set::segment {} : pt.segments.back ();
+
+        // tokens, already normalized
+
+        for (auto p = line.tokens; p != previous.size (); ++p) {
+            auto t = previous [p];
+            t.location.row += rows;
+            this->pattern.push_back (t);
+        }
+
+        // plain text
+
+        std::copy (text_tail.cbegin () + (line.text - base.text), text_tail.cend (), std::back_inserter (this->plaintext.text));
+        const auto skipped = std::lower_bound (underscores_tail.cbegin (), underscores_tail.cend (), line.text);
+        std::copy (folded_tail.cbegin () + std::min ((std::size_t) (line.text - base.text) - (skipped - underscores_tail.cbegin ()), folded_tail.size ()),
+                   folded_tail.cend (), std::back_inserter (this->plaintext.folded));
+        for (auto i = skipped; i != underscores_tail.cend (); ++i) {
+            this->plaintext.underscores.push_back (*i + characters);
+        }
+
+        for (auto i = pieces_tail.begin () + (line.pieces - base.pieces); i != pieces_tail.end (); ++i) {
+            this->plaintext.pieces.push_back ({ i->offset + characters, { i->location.row + rows, i->location.column } });
+        }
+        for (auto i = segments_tail.begin () + (line.segments - base.segments); i != segments_tail.end (); ++i) {
+            this->plaintext.segments.push_back ({ i->offset + characters, i->type });
+        }
+
+        // lines and lexer state
+
+        for (auto i = tail.begin () + j; i != tail.end (); ++i) {
+            auto state = *i;
+            state.tokens += tokens;
+            state.text += characters;
+            state.pieces += pieces;
+            state.segments += segments;
+            if (i->text == line.text) {
+                state.last = last;
+            }
+            if (i->segments != line.segments) {
+                state.segment.offset += characters;
+            } else {
+                state.segment = segment;
+            }
+            state.lexer.location.row += rows;
+            this->lines.push_back (state);
+        }
+
+        this->current = end.first;
+        this->current.location.row += rows;
+        this->single_line_comment = end.second;
+    }
+
+    this->index ();
+}
+
+template <typename Config>
+std::vector <std::vector <typename basic_agsearch <Config>::clone>> basic_agsearch <Config>::clones (std::size_t minimum) const {
+    const basic_agsearch * documents [] = { this };
+    return basic_agsearch::clones (documents, minimum);
+}
+
+template <typename Config>
+std::vector <std::vector <typename basic_agsearch <Config>::clone>>
+basic_agsearch <Config>::clones (std::span <const basic_agsearch * const> documents, std::size_t minimum) {
+    std::vector <std::vector <clone>> result;
+    if (documents.empty () || !minimum)
+        return result;
+
+    const auto & parameters = documents.front ()->parameters;
+
+    // keys of tokens, equal when the tokens compare equal as whole words
+    //  - canonical forms are interned across all vocabularies, low 3 bits are token type
+    //  - numeric values and alternative spellings get keys of their own, type 5 and 6
+
+    std::unordered_map <unit_string, std::uint64_t> forms;
+    std::map <std::tuple <std::uint64_t, double, bool>, std::uint64_t> numbers;
+    std::vector <std::vector <std::uint64_t>> keys (documents.size ());
+
+    const auto spelling = [&forms] (const spelling_set & spellings) {
+        return forms.try_emplace (narrow (*spellings.cbegin ()), forms.size ()).first->second * 8 + 6;
+    };
+
+    for (std::size_t d = 0; d != documents.size (); ++d) {
+        const auto & vocabulary = documents [d]->vocabulary;
+
+        std::vector <std::uint64_t> canonicals (vocabulary.canonicals->size ());
+        for (const auto & [form, id] : *vocabulary.canonicals) {
+            canonicals [id] = forms.try_emplace (form, forms.size ()).first->second;
+        }
+
+        std::vector <std::uint64_t> spelled (vocabulary.entries.size ());
+        for (std::size_t e = 0; e != vocabulary.entries.size (); ++e) {
+            for (auto & as : alternative_spellings) {
+                if ((parameters.*as.option) && as.spellings.contains (vocabulary.entries [e].value)) {
+                    spelled [e] = spelling (as.spellings);
+                }
+            }
+        }
+
+        keys [d].reserve (documents [d]->pattern.size ());
+        for (const auto & t : documents [d]->pattern) {
+            auto key = spelled [t.key];
+
+            if (!key && t.opt_alt_spelling_allowed) {
+                for (auto & as : alternative_spellings_optional) {
+                    if ((parameters.*as.option) && as.spellings.contains (vocabulary.entries [t.key].value)) {
+                        key = spelling (as.spellings);
+                    }
+                }
+            }
+            if (!key && parameters.numbers && (t.type == token::type::numeric)) {
+                const auto value = std::make_tuple (t.integer, t.decimal, t.is_decimal && !parameters.match_floats_and_integers);
+                key = numbers.try_emplace (value, numbers.size ()).first->second * 8 + 5;
+            }
+            if (!key) {
+                key = canonicals [t.canonical] * 8 + (std::uint64_t) t.type;
+            }
+            keys [d].push_back (key);
+        }
+    }
+
+    // rolling hashes of all windows of 'minimum' tokens, sorted so that equal windows are adjacent
+
+    struct window {
+        std::uint64_t hash;
+        std::uint32_t document;
+        std::uint32_t position;
+    };
+    std::vector <window> windows;
+    windows.reserve (std::accumulate (keys.cbegin (), keys.cend (), std::size_t (0),
+                                      [] (std::size_t n, const auto & k) { return n + k.size (); }));
+
+    constexpr auto base = 0x9E37'79B9'7F4A'7C15uLL;
+    auto power = 1uLL; // base ^ minimum
+    for (std::size_t i = 0; i != minimum; ++i) {
+        power *= base;
+    }
+
+    for (std::uint32_t d = 0; d != documents.size (); ++d) {
+        const auto & k = keys [d];
+
+        auto h = 0uLL;
+        for (std::size_t p = 0; p != k.size (); ++p) {
+            h = h * base + clone_hash (k [p]);
+            if (p >= minimum) {
+                h -= power * clone_hash (k [p - minimum]);
+            }
+            if (p + 1 >= minimum) {
+                windows.push_back ({ h, d, (std::uint32_t) (p + 1 - minimum) });
+            }
+        }
+    }
+    std::sort (windows.begin (), windows.end (), [] (const window & a, const window & b) {
+        return std::tie (a.hash, a.document, a.position) < std::tie (b.hash, b.document, b.position);
+    });
+
+    // windows found more than once, instances in document and position order
+    //  - windows of equal hash are compared, the rare different ones are split to separate groups
+    //  - 'group' of window starting at each position, if repeated
+
+    std::vector <std::vector <std::pair <std::uint32_t, std::uint32_t>>> members;
+    std::vector <std::vector <std::uint32_t>> group (documents.size ());
+
+    for (std::uint32_t d = 0; d != documents.size (); ++d) {
+        group [d].assign (keys [d].size (), vocabulary_set::no_key);
+    }
+    const auto equal = [&keys, minimum] (const window & a, const window & b) {
+        return std::equal (keys [a.document].begin () + a.position, keys [a.document].begin () + a.position + minimum,
+                           keys [b.document].begin () + b.position);
+    };
+
+    for (auto i = windows.begin (); i != windows.end (); ) {
+        auto j = std::find_if (i, windows.end (), [h = i->hash] (const window & w) { return w.hash != h; });
+
+        for (auto w = i; w != j; ++w) {
+            if ((w->document == vocabulary_set::no_key) || !std::any_of (std::next (w), j, [&] (const window & other) {
+                return (other.document != vocabulary_set::no_key) && equal (*w, other);
+            }))
+                continue;
+
+            auto & instances = members.emplace_back ();
+            for (auto v = w; v != j; ++v) {
+                if ((v->document != vocabulary_set::no_key) && ((v == w) || equal (*w, *v))) {
+                    instances.push_back ({ v->document, v->position });
+                    group [v->document][v->position] = (std::uint32_t) (members.size () - 1);
+                    if (v != w) {
+                        v->document = vocabulary_set::no_key; // taken
+                    }
+                }
+            }
+        }
+        i = j;
+    }
+    windows.clear ();
+
+    // report groups that don't continue group of the same instances one token earlier, extended to the right
+    //  - in order of their first instances
+
+    std::vector <std::uint32_t> order (members.size ());
+    std::iota (order.begin (), order.end (), 0u);
+    std::sort (order.begin (), order.end (), [&members] (std::uint32_t a, std::uint32_t b) {
+        return members [a].front () < members [b].front ();
+    });
+
+    for (auto index : order) {
+        const auto & instances = members [index];
+        auto previous = vocabulary_set::no_key;
+        auto inner = true;
+
+        for (const auto & [d, p] : instances) {
+            const auto g = p ? group [d][p - 1] : vocabulary_set::no_key;
+            if ((g == vocabulary_set::no_key) || ((previous != vocabulary_set::no_key) && (g != previous))) {
+                inner = false;
+                break;
+            }
+            previous = g;
+        }
+        if (inner && (members [previous].size () == instances.size ()))
+            continue;
+
+        const auto [d0, p0] = instances.front ();
+        auto length = minimum;
+
+        while (std::all_of (instances.cbegin (), instances.cend (), [&, d0 = d0, p0 = p0] (const auto & instance) {
+            const auto & k = keys [instance.first];
+            return (instance.second + length < k.size ())
+                && (k [instance.second + length] == keys [d0][p0 + length]);
+        })) {
+            ++length;
+        }
+
+        auto & reported = result.emplace_back ();
+        reported.reserve (instances.size ());
+
+        for (const auto & [d, p] : instances) {
+            const auto & pattern = documents [d]->pattern;
+            const auto & begin = pattern [p];
+            const auto & end = pattern [p + length - 1];
+
+            reported.push_back ({ d, begin.location, { end.location.row, end.location.column + end.length } });
+        }
+    }
+    return result;
+}
+
+// explicit instantiations
+//  - define AGSEARCH_CONFIGURATIONS as a header with 'template class basic_agsearch <...>;' for additional configurations
+
+template class basic_agsearch <agsearch_dynamic_config>;
+
+#ifdef AGSEARCH_CONFIGURATIONS
+#include AGSEARCH_CONFIGURATIONS
+#endif
@@ -5,77 +5,386 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <iterator>
+#include <compare>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <stop_token>
+#include <type_traits>
+#include <optional>
 
-// agsearch
-//  - coding style -agnostic searcher
-//  - https://github.com/tringi/code-style-agnostic-search
+// agsearch_parameter_set
+//  - search options
+//  - majority is used on 'load'/'append' and the source must be reloaded on change of parameters
+//
+struct agsearch_parameter_set {
+    bool whole_words = false; // match only whole words
+    bool individual_partial_words = false; // match partial words even individually
+    bool subword_boundaries = false; // partial words must start at camelCase/snake_case word boundary
+    bool orthogonal = false; // match code in code only, strings in string, and comments in comments
+
+    bool case_insensitive_numbers = true;
+    bool case_insensitive_strings = true;
+    bool case_insensitive_comments = true;
+    bool case_insensitive_identifiers = true;
+    
+    bool fold_and_ignore_diacritics_strings = true;
+    bool fold_and_ignore_diacritics_comments = true;
+    bool fold_and_ignore_diacritics_identifiers = true;
+
+    bool digraphs = true;   // match digraphs to corresponding tokens
+    bool trigraphs = true;  // match trigraphs to corresponding tokens TODO: do not implement
+    bool iso646 = true;     // match ISO646 tokens to corresponding operators
+
+    bool ignore_all_syntactic_tokens = false; // simply do not insert tokens to pattern
+    bool ignore_all_parentheses = false;
+    bool ignore_all_brackets = false;
+    bool ignore_all_braces = false;
+    bool ignore_trailing_semicolons = false;
+    bool ignore_trailing_commas = false;
+    bool ignore_all_semicolons = false;
+    bool ignore_all_commas = false;
+
+    // numerics
+
+    bool numbers = true; // match different numeric notations
+    bool match_floats_and_integers = true;
+
+    bool nullptr_is_0 = true;
+    bool boolean_is_integer = true;
+
+    // strings
+
+    bool unescape = true;
+    bool ignore_accelerator_hints_in_strings = true;
+
+    // comments
+
+    bool undecorate_comments = true; // ignore sequences of * characters in comments
+
+    // token transformations
+
+    bool match_snake_and_camel_casing = true;
+    bool match_ifs_and_conditional = true;
+    bool match_class_struct_typename = true;
+    bool match_any_inheritance_type = true;
+    bool match_any_integer_decl_style = true;
+    bool match_float_and_double_decl = true;
+    bool match_using_and_typedef = false;
+
+    // TODO: reorder "const volatile", "static inline", 
+    // TODO: ignore nontype decl specs: "static inline virtual...
+
+};
+
+// agsearch_code_unit
+//  - default type the searcher stores text in: UTF-16, i.e. wchar_t where it is 16-bit (Windows) and char16_t where it is 32-bit
+//  - the API takes and returns wide strings regardless, see 'basic_agsearch::narrow' and 'widen'
+//
+using agsearch_code_unit = std::conditional_t <sizeof (wchar_t) == 2, wchar_t, char16_t>;
+
+// agsearch_dynamic_config
+//  - 'parameters' can be changed at runtime, the source must be reloaded afterwards
+//
+struct agsearch_dynamic_config {
+    using code_unit = agsearch_code_unit;
+    agsearch_parameter_set parameters;
+};
+
+// agsearch_static_config
+//  - 'parameters' are fixed at compile time, so that tests of disabled features compile away
+//  - e.g.: constexpr agsearch_parameter_set strict = { .whole_words = true };
+//          using strict_search = basic_agsearch <agsearch_static_config <strict>>;
+//  - 'CodeUnit' selects type the text is stored in, wchar_t or char16_t
+//  - every such configuration must be instantiated in agsearch.cpp, see AGSEARCH_CONFIGURATIONS
+//
+template <const agsearch_parameter_set & Parameters, typename CodeUnit = agsearch_code_unit>
+struct agsearch_static_config {
+    using code_unit = CodeUnit;
+    static constexpr const agsearch_parameter_set & parameters = Parameters;
+};
+
+// agsearch_segmented_vector
+//  - sequence of fixed-size segments with stable addresses, growing never moves existing elements
+//  - copies share segments, segment is copied only when changed while shared (see 'snapshot')
 //
-class agsearch {
+template <typename T, std::size_t N>
+class agsearch_segmented_vector {
+    static_assert ((N & (N - 1)) == 0, "segment size must be power of 2");
+
+    std::vector <std::shared_ptr <std::vector <T>>> segments;
+    std::vector <T *> bases; // data of 'segments' for direct access
+    std::size_t n = 0;
+
 public:
+    template <typename Container, typename Value>
+    class basic_iterator {
+        Container * c = nullptr;
+        std::size_t i = 0;
 
-    // parameters
-    //  - search options
-    //  - majority is used on 'load'/'append' and the source must be reloaded on change of parameters
-    //
-    struct parameter_set {
-        bool whole_words = false; // match only whole words
-        bool individual_partial_words = false; // match partial words even individually
-        bool orthogonal = false; // match code in code only, strings in string, and comments in comments
-
-        bool case_insensitive_numbers = true;
-        bool case_insensitive_strings = true;
-        bool case_insensitive_comments = true;
-        bool case_insensitive_identifiers = true;
-        
-        bool fold_and_ignore_diacritics_strings = true;
-        bool fold_and_ignore_diacritics_comments = true;
-        bool fold_and_ignore_diacritics_identifiers = true;
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::remove_const_t <Value>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value *;
+        using reference = Value &;
 
-        bool digraphs = true;   // match digraphs to corresponding tokens
-        bool trigraphs = true;  // match trigraphs to corresponding tokens TODO: do not implement
-        bool iso646 = true;     // match ISO646 tokens to corresponding operators
+        basic_iterator () = default;
+        basic_iterator (Container * c, std::size_t i) : c (c), i (i) {}
 
-        bool ignore_all_syntactic_tokens = false; // simply do not insert tokens to pattern
-        bool ignore_all_parentheses = false;
-        bool ignore_all_brackets = false;
-        bool ignore_all_braces = false;
-        bool ignore_trailing_semicolons = false;
-        bool ignore_trailing_commas = false;
-        bool ignore_all_semicolons = false;
-        bool ignore_all_commas = false;
+        template <typename C, typename V>
+        basic_iterator (const basic_iterator <C, V> & other) : c (other.c), i (other.i) {}
 
-        // numerics
+        reference operator * () const { return (*this->c) [this->i]; }
+        pointer operator -> () const { return &(*this->c) [this->i]; }
+        reference operator [] (difference_type d) const { return (*this->c) [this->i + d]; }
 
-        bool numbers = true; // match different numeric notations
-        bool match_floats_and_integers = true;
+        basic_iterator & operator ++ () { ++this->i; return *this; }
+        basic_iterator & operator -- () { --this->i; return *this; }
+        basic_iterator operator ++ (int) { auto r = *this; ++this->i; return r; }
+        basic_iterator operator -- (int) { auto r = *this; --this->i; return r; }
+        basic_iterator & operator += (difference_type d) { this->i += d; return *this; }
+        basic_iterator & operator -= (difference_type d) { this->i -= d; return *this; }
 
-        bool nullptr_is_0 = true;
-        bool boolean_is_integer = true;
+        friend basic_iterator operator + (basic_iterator it, difference_type d) { return it += d; }
+        friend basic_iterator operator + (difference_type d, basic_iterator it) { return it += d; }
+        friend basic_iterator operator - (basic_iterator it, difference_type d) { return it -= d; }
+        friend difference_type operator - (const basic_iterator & a, const basic_iterator & b) { return (difference_type) (a.i - b.i); }
 
-        // strings
+        friend bool operator == (const basic_iterator & a, const basic_iterator & b) { return a.i == b.i; }
+        friend auto operator <=> (const basic_iterator & a, const basic_iterator & b) { return a.i <=> b.i; }
 
-        bool unescape = true;
-        bool ignore_accelerator_hints_in_strings = true;
+        template <typename, typename> friend class basic_iterator;
+    };
 
-        // comments
+    static constexpr std::size_t segment_size = N;
 
-        bool undecorate_comments = true; // ignore sequences of * characters in comments
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = basic_iterator <agsearch_segmented_vector, T>;
+    using const_iterator = basic_iterator <const agsearch_segmented_vector, const T>;
+    using const_reverse_iterator = std::reverse_iterator <const_iterator>;
 
-        // token transformations
+    std::size_t size () const noexcept { return this->n; }
+    bool empty () const noexcept { return this->n == 0; }
 
-        bool match_snake_and_camel_casing = true;
-        bool match_ifs_and_conditional = true;
-        bool match_class_struct_typename = true;
-        bool match_any_inheritance_type = true;
-        bool match_any_integer_decl_style = true;
-        bool match_float_and_double_decl = true;
-        bool match_using_and_typedef = false;
+    const T & operator [] (std::size_t i) const { return this->bases [i / N] [i % N]; }
+    T & operator [] (std::size_t i) { return this->own (i / N) [i % N]; }
 
-        // TODO: matching different int declarations (rather than through ignored_patterns)
-        // TODO: reorder "const volatile", "static inline", 
-        // TODO: ignore nontype decl specs: "static inline virtual...
+    const T & front () const { return (*this) [0]; }
+    const T & back () const { return (*this) [this->n - 1]; }
+    T & front () { return (*this) [0]; }
+    T & back () { return (*this) [this->n - 1]; }
 
-    } parameters;
+    iterator begin () { return { this, 0 }; }
+    iterator end () { return { this, this->n }; }
+    const_iterator begin () const { return { this, 0 }; }
+    const_iterator end () const { return { this, this->n }; }
+    const_iterator cbegin () const { return { this, 0 }; }
+    const_iterator cend () const { return { this, this->n }; }
+    const_reverse_iterator crbegin () const { return const_reverse_iterator (this->cend ()); }
+    const_reverse_iterator crend () const { return const_reverse_iterator (this->cbegin ()); }
+
+    void push_back (const T & value) {
+        if (this->n % N == 0) {
+            auto segment = std::make_shared <std::vector <T>> ();
+            segment->reserve (N);
+            this->bases.push_back (segment->data ());
+            this->segments.push_back (std::move (segment));
+        }
+        this->own (this->n / N);
+        this->segments.back ()->push_back (value);
+        ++this->n;
+    }
+    void pop_back () {
+        this->own ((this->n - 1) / N);
+        this->segments.back ()->pop_back ();
+        if (--this->n % N == 0) {
+            this->segments.pop_back ();
+            this->bases.pop_back ();
+        }
+    }
+    void resize (std::size_t size) {
+        if (this->n > size) {
+            this->segments.resize ((size + N - 1) / N);
+            this->bases.resize (this->segments.size ());
+            if (size % N) {
+                this->own (size / N);
+                this->segments.back ()->resize (size % N);
+            }
+            this->n = size;
+        }
+        while (this->n < size) {
+            this->push_back (T {});
+        }
+    }
+    void clear () {
+        this->segments.clear ();
+        this->bases.clear ();
+        this->n = 0;
+    }
+    template <typename Iterator>
+    void assign (Iterator first, Iterator last) {
+        this->clear ();
+        for (; first != last; ++first) {
+            this->push_back (*first);
+        }
+    }
+
+private:
+
+    // own
+    //  - copies segment shared with other instance before it's changed
+    //
+    T * own (std::size_t s) {
+        auto & segment = this->segments [s];
+        if (segment.use_count () > 1) {
+            auto copy = std::make_shared <std::vector <T>> ();
+            copy->reserve (N);
+            copy->assign (segment->cbegin (), segment->cend ());
+
+            segment = std::move (copy);
+            this->bases [s] = segment->data ();
+        }
+        return this->bases [s];
+    }
+};
+
+// agsearch_shared
+//  - value shared by copies, copied only when changed while shared, like segments of 'agsearch_segmented_vector'
+//  - const access never copies, non-const one does when the value is shared (see 'own')
+//
+template <typename T>
+class agsearch_shared {
+    std::shared_ptr <T> value = std::make_shared <T> ();
+
+public:
+    const T & operator * () const { return *this->value; }
+    const T * operator -> () const { return this->value.get (); }
+    T & operator * () { return this->own (); }
+    T * operator -> () { return &this->own (); }
+
+private:
+
+    // own
+    //  - copies value shared with other instance before it's changed
+    //
+    T & own () {
+        if (this->value.use_count () > 1) {
+            this->value = std::make_shared <T> (std::as_const (*this->value));
+        }
+        return *this->value;
+    }
+};
+
+// agsearch_task
+//  - search running on worker thread, returned by 'find_async'
+//  - destroying the task, or assigning another one over it, requests stop and joins the worker, which stops within 'step' tokens,
+//    unlike std::future of std::async that waits for the whole search to finish
+//
+class agsearch_task {
+    std::future <std::size_t> result;
+    std::jthread              worker;
+
+public:
+    agsearch_task () = default;
+
+    template <typename F>
+    explicit agsearch_task (F && f) {
+        std::promise <std::size_t> promise;
+        this->result = promise.get_future ();
+        this->worker = std::jthread ([f = std::forward <F> (f), promise = std::move (promise)] (std::stop_token stop) mutable {
+            try {
+                promise.set_value (f (stop));
+            } catch (...) {
+                promise.set_exception (std::current_exception ());
+            }
+        });
+    }
+
+    // valid
+    //  - task was started and its result not taken yet
+    //
+    bool valid () const { return this->result.valid (); }
+
+    // ready
+    //  - the worker finished, 'get' won't wait
+    //
+    bool ready () const {
+        return this->result.valid ()
+            && this->result.wait_for (std::chrono::seconds (0)) == std::future_status::ready;
+    }
+
+    // wait
+    //  - waits for the search to finish, without requesting stop
+    //
+    void wait () const { this->result.wait (); }
+
+    // stop
+    //  - requests stop and joins the worker, number of instances reported until then is left for 'get'
+    //
+    void stop () {
+        if (this->worker.joinable ()) {
+            this->worker.request_stop ();
+            this->worker.join ();
+        }
+    }
+
+    // get
+    //  - waits for the search to finish and returns number of instances reported
+    //
+    std::size_t get () { return this->result.get (); }
+};
+
+// basic_agsearch
+//  - coding style -agnostic searcher
+//  - https://github.com/tringi/code-style-agnostic-search
+//  - const members keep all search state in 'query', so any number of threads can search single loaded instance at once,
+//    only 'clear', 'append', 'load' and 'find' with virtual 'found' callback must not run concurrently with anything
+//
+template <typename Config>
+class basic_agsearch : public Config {
+public:
+
+    // parameters
+    //  - 'parameters' member is provided by 'Config', see 'agsearch_dynamic_config'
+    //
+    using parameter_set = agsearch_parameter_set;
+
+    // code_unit
+    //  - type the vocabulary and plain text are stored in, provided by 'Config', see 'agsearch_code_unit'
+    //  - 'wide_text' is stored text seen through the wide API: view where 'code_unit' is wchar_t, converted copy otherwise
+    //
+    using code_unit = typename Config::code_unit;
+    using unit_string = std::basic_string <code_unit>;
+    using unit_view = std::basic_string_view <code_unit>;
+    using wide_text = std::conditional_t <std::is_same_v <code_unit, wchar_t>, std::wstring_view, std::wstring>;
+
+    static_assert (std::is_same_v <code_unit, wchar_t> || std::is_same_v <code_unit, char16_t>, "text is stored as wchar_t or UTF-16");
+
+    // narrow
+    //  - converts wide string to stored code units, characters outside BMP become surrogate pairs when wchar_t is 32-bit
+    //
+    static unit_string narrow (std::wstring_view);
+
+    // widen
+    //  - converts stored code units back to wide string, only views them when 'code_unit' is wchar_t
+    //
+    static wide_text widen (unit_view);
+
+    // widen (buffer)
+    //  - as above, converting into 'buffer' that is reused between calls, instead of allocating new string
+    //
+    static std::wstring_view widen (unit_view, std::wstring & buffer);
 
     // location
     //  - describes position in the original source text
@@ -118,13 +427,347 @@ public:
         this->normalize_full ();
     }
 
+    // reload
+    //  - replaces loaded text with new version of the same text, e.g. after the file changed on disk
+    //  - lines unchanged at the start and at the end are reused, only lines between are processed again
+    //  - 'parameters' must not change since the text was loaded
+    //
+    template <typename Container>
+    void reload (const Container & text) {
+        std::vector <std::wstring_view> lines;
+        for (auto & line : text) {
+            std::wstring_view input (line);
+
+            std::size_t i;
+            while ((i = input.find (L'\n')) != std::wstring_view::npos) {
+                lines.push_back (input.substr (0, i));
+                input.remove_prefix (i + 1);
+            }
+            lines.push_back (input);
+        }
+        this->reload_lines (lines);
+    }
+
+    // snapshot
+    //  - immutable reference-counted copy of the loaded text and indexes, all are shared until changed, see 'vocabulary'
+    //  - searches on the snapshot continue undisturbed while this instance is changed, see 'basic_agsearch_versions'
+    //
+    std::shared_ptr <const basic_agsearch> snapshot () const {
+        return std::make_shared <const basic_agsearch> (*this);
+    }
+
     // find
     //  - searches for instances of 'needle' in loaded code
     //  - for each found instance, calls 'found' virtual callback
     //  - returns number of instances found
+    //  - for concurrent searches use const 'find' with visitor below, 'matches' or 'compile' and 'next'
     //
     std::size_t find (std::wstring_view needle);
 
+    // match
+    //  - single found instance
+    //
+    struct match {
+        location begin;
+        location end;
+    };
+
+    // query
+    //  - compiled needle and state of its search, continued by each call to 'next' or 'find_all'
+    //  - valid only until the loaded text changes
+    //
+    struct query;
+
+    // compile
+    //  - converts 'needle' to query for 'next' and 'find_all'
+    //  - when 'needle' only extends needle of complete 'previous' query, e.g. while typing, only positions
+    //    where 'previous' matched are verified, instead of searching all text again
+    //  - wildcards in 'needle': '$id' any identifier, '$num' any number, '$any' one or more tokens with balanced brackets,
+    //    e.g. parenthesized group, '$...' the same but possibly none; '$any' and '$...' span at most 256 tokens
+    //  - '$num[low, high]' is any number in the range, '$num{a, b, ...}' any of the numbers, see 'find_numbers'
+    //
+    query compile (std::wstring_view needle, const query * previous = nullptr) const;
+
+    // is_complete
+    //  - query was searched through all text, and can be used as 'previous' for 'compile'
+    //
+    bool is_complete (const query &) const;
+
+    // next
+    //  - finds next instance of the query, returns false when there are no more
+    //  - with 'limit' gives up after scanning that many tokens, returning false without setting 'query::done'
+    //
+    bool next (query &, match &, std::size_t limit = (std::size_t) -1) const;
+
+    // find_all
+    //  - fills 'buffer' with next instances of the query
+    //  - returns the filled part of 'buffer', which is empty when there are no more instances
+    //
+    std::span <match> find_all (query &, std::span <match> buffer) const;
+
+    // find_next
+    //  - finds first instance of the query that starts at or after 'from', e.g. editor cursor
+    //  - subsequent 'next' continues from there
+    //
+    bool find_next (query &, location from, match &) const;
+
+    // find_previous
+    //  - finds last instance of the query that starts before 'from'
+    //  - scans backwards in doubling windows, so it stops near 'from' when there is an instance close to it
+    //
+    bool find_previous (query &, location from, match &) const;
+
+    // next_approximate
+    //  - finds next instance of the query with at most 'errors' tokens inserted, deleted or substituted
+    //  - tokens are compared as in 'next', whole, and the number of errors of the instance is returned through 'found'
+    //  - instances don't overlap, of overlapping ones the one with fewer errors is found
+    //  - needle is limited to 63 tokens, query must not be used with 'next' and 'errors' must not change between calls
+    //
+    bool next_approximate (query &, std::size_t errors, match &, std::size_t * found = nullptr) const;
+
+    // find_async
+    //  - searches for 'needle' on worker thread, the searcher must not be modified until the returned task is finished or stopped
+    //  - 'report' (std::span <const match> batch, std::size_t scanned, std::size_t total) is called on the worker thread
+    //    with newly found instances at least every 'step' tokens scanned, and finally with 'scanned' == 'total'
+    //  - stops within 'step' tokens after stop is requested through 'cancel' or the task, without the final report
+    //  - the task returns number of instances reported, see 'agsearch_task'
+    //
+    template <typename Report>
+    agsearch_task find_async (std::wstring_view needle, std::stop_token cancel, Report report, std::size_t step = 0x10000) const {
+        return this->find_async (needle, 0, 0, std::move (cancel), std::move (report), step);
+    }
+
+    // find_async (viewport)
+    //  - as above, but instances starting in rows [first_row, last_row), e.g. visible in editor, are searched and reported first
+    //  - the search then continues alternately below and above those rows, 'step' tokens at a time
+    //
+    template <typename Report>
+    agsearch_task find_async (std::wstring_view needle, std::uint32_t first_row, std::uint32_t last_row,
+                              std::stop_token cancel, Report report, std::size_t step = 0x10000) const {
+        return agsearch_task ([this, needle = std::wstring (needle), first_row, last_row, cancel, report = std::move (report), step] (std::stop_token stop) mutable {
+            auto q = this->compile (needle);
+            return this->search_viewport (q, first_row, last_row, cancel, stop, report, step);
+        });
+    }
+
+    // find_async (query)
+    //  - as above, for query compiled by caller, which must be kept until the returned task is finished or stopped
+    //  - the query then can be 'previous' for next 'compile'
+    //
+    template <typename Report>
+    agsearch_task find_async (query & q, std::uint32_t first_row, std::uint32_t last_row,
+                              std::stop_token cancel, Report report, std::size_t step = 0x10000) const {
+        return agsearch_task ([this, &q, first_row, last_row, cancel, report = std::move (report), step] (std::stop_token stop) mutable {
+            return this->search_viewport (q, first_row, last_row, cancel, stop, report, step);
+        });
+    }
+
+    // matches
+    //  - lazy range of found instances, the search advances only as the range is iterated
+    //  - e.g.: first page of results is 'range | std::views::take (50)', iterating the range again continues with next page
+    //  - the range is valid only until the loaded text changes
+    //
+    class match_range;
+    match_range matches (std::wstring_view needle) const;
+
+    // find
+    //  - calls 'visitor' (begin, end) for every found instance, instead of 'found' virtual callback
+    //  - if 'visitor' returns bool, returning false stops the search
+    //  - returns number of instances found
+    //
+    template <typename Visitor>
+    std::size_t find (std::wstring_view needle, Visitor && visitor) const {
+        auto q = this->compile (needle);
+
+        match m;
+        std::size_t n = 0;
+
+        while (this->next (q, m)) {
+            ++n;
+            if (!visit (visitor, m))
+                break;
+        }
+        return n;
+    }
+
+    // find (rows)
+    //  - calls 'visitor' (begin, end) for every instance starting in rows [first_row, last_row)
+    //  - the rows are located through row index, so the cost depends on the range only
+    //
+    template <typename Visitor>
+    std::size_t find (std::wstring_view needle, std::uint32_t first_row, std::uint32_t last_row, Visitor && visitor) const {
+        auto q = this->compile (needle);
+        if (q.done)
+            return 0;
+
+        auto [begin, end] = this->range (q, first_row, last_row);
+        this->seek (q, begin);
+
+        match m;
+        std::size_t n = 0;
+
+        while ((q.position < end) && this->next (q, m, end - q.position)) {
+            ++n;
+            if (!visit (visitor, m))
+                break;
+        }
+        return n;
+    }
+
+    // condition
+    //  - instance of 'needle' must (or if 'negated' must not) start at most 'rows' rows before or after instance being found
+    //  - 'rows' of (std::uint32_t) -1 means anywhere in the text
+    //  - with 'same_body' the instance must instead start inside the innermost braces enclosing instance being found,
+    //    nested ones included, e.g. in the same function; 'rows' is then ignored
+    //
+    struct condition {
+        std::wstring_view needle;
+        std::uint32_t     rows = 0;
+        bool              negated = false;
+        bool              same_body = false;
+    };
+
+    // find (conditions)
+    //  - calls 'visitor' (begin, end) for every instance of 'needle' that satisfies all 'conditions'
+    //  - e.g. "lock" with { "unlock", 20 } are locks with unlock within 20 rows, adding { "return", 5, true } excludes those near return,
+    //    "malloc" with { "free", 0, true, true } are allocations in function bodies that don't free anything
+    //  - all needles are searched forward once and their instances merge-joined by row, the search skips rows too far from
+    //    instances of required needles, so the cost is about the sum of separate searches
+    //  - 'same_body' conditions are searched again only between braces of each new body, not merge-joined
+    //  - instance of condition may be the same code as the instance found, when both needles match it
+    //
+    template <typename Visitor>
+    std::size_t find (std::wstring_view needle, std::span <const condition> conditions, Visitor && visitor) const {
+        auto q = this->compile (needle);
+
+        std::vector <condition_state> states;
+        states.reserve (conditions.size ());
+
+        for (const auto & c : conditions) {
+            states.push_back ({ c.rows, c.negated, c.same_body, this->compile (c.needle) });
+        }
+
+        match m;
+        std::size_t n = 0;
+
+        while (this->skip (q, states) && this->next (q, m)) {
+            if (std::all_of (states.begin (), states.end (), [this, &m] (condition_state & state) { return this->satisfied (state, m); })) {
+                ++n;
+                if (!visit (visitor, m))
+                    break;
+            }
+        }
+        return n;
+    }
+
+    // matching_bracket
+    //  - finds bracket paired with the one starting at 'at', e.g. to jump to matching brace, parenthesis or square bracket
+    //  - returns false if there's no bracket at 'at' or it's not paired
+    //
+    bool matching_bracket (location at, location & partner) const;
+
+    // depth
+    //  - number of braces enclosing 'at', from the brace index built by 'load'
+    //
+    std::uint32_t depth (location at) const;
+
+    // find_in_body
+    //  - calls 'visitor' (begin, end) for every instance starting inside the innermost braces enclosing 'at',
+    //    e.g. the function the cursor is in; the whole text if there are none
+    //  - only tokens inside the braces are scanned
+    //
+    template <typename Visitor>
+    std::size_t find_in_body (std::wstring_view needle, location at, Visitor && visitor) const {
+        auto q = this->compile (needle);
+        if (q.done)
+            return 0;
+
+        auto [begin, end] = this->body (at);
+
+        std::size_t n = 0;
+        this->visit_between (q, begin, end, visitor, n);
+        return n;
+    }
+
+    // find_at_namespace_scope
+    //  - calls 'visitor' (begin, end) for every instance starting outside of any braces other than namespace
+    //    or 'extern "C"' ones, i.e. in declarations, not in function or class bodies
+    //  - bodies are skipped through the brace index, without scanning their tokens
+    //
+    template <typename Visitor>
+    std::size_t find_at_namespace_scope (std::wstring_view needle, Visitor && visitor) const {
+        auto q = this->compile (needle);
+        if (q.done)
+            return 0;
+
+        std::size_t n = 0;
+        for (const auto & [begin, end] : this->namespace_scope ()) {
+            if (!this->visit_between (q, begin, end, visitor, n))
+                break;
+        }
+        return n;
+    }
+
+    // find_approximate
+    //  - calls 'visitor' (begin, end) for every instance of 'needle' with at most 'errors' tokens different, see 'next_approximate'
+    //  - needle tokens are tested against pattern tokens bit-parallel (Wu-Manber), so the scan cost doesn't grow with 'errors' much
+    //
+    template <typename Visitor>
+    std::size_t find_approximate (std::wstring_view needle, std::size_t errors, Visitor && visitor) const {
+        auto q = this->compile (needle);
+
+        match m;
+        std::size_t n = 0;
+
+        while (this->next_approximate (q, errors, m)) {
+            ++n;
+            if (!visit (visitor, m))
+                break;
+        }
+        return n;
+    }
+
+    // find_numbers
+    //  - calls 'visitor' (begin, end) for every number with value in [low, high], in order of position
+    //  - numbers are found by binary search in index sorted by value, the cost depends on the number of instances only
+    //  - returns number of instances found
+    //
+    template <typename Visitor>
+    std::size_t find_numbers (double low, double high, Visitor && visitor) const {
+        return this->visit_positions (this->numeric_positions ({ { low, high } }), visitor);
+    }
+
+    // find_numbers (set)
+    //  - as above, for every number equal to any of 'values', e.g. list of error codes
+    //
+    template <typename Visitor>
+    std::size_t find_numbers (std::span <const double> values, Visitor && visitor) const {
+        std::vector <std::pair <double, double>> ranges;
+        ranges.reserve (values.size ());
+        for (auto value : values) {
+            ranges.push_back ({ value, value });
+        }
+        return this->visit_positions (this->numeric_positions (ranges), visitor);
+    }
+
+    // clone
+    //  - single instance of duplicated code, 'document' indexes 'documents' passed to 'clones'
+    //
+    struct clone {
+        std::size_t document;
+        location    begin;
+        location    end;
+    };
+
+    // clones
+    //  - finds groups of equal token sequences at least 'minimum' tokens long, within and across loaded 'documents'
+    //  - tokens are equal when they'd match as whole words, i.e. formatting, naming style or numeric notation don't matter
+    //  - windows of 'minimum' tokens are grouped by rolling hash, each group is reported once, extended to its maximal length
+    //  - all documents must be loaded with the same 'parameters'
+    //
+    static std::vector <std::vector <clone>> clones (std::span <const basic_agsearch * const> documents, std::size_t minimum);
+    std::vector <std::vector <clone>> clones (std::size_t minimum) const;
+
 public:
 //protected:
 
@@ -142,8 +785,6 @@ public:
             numeric,
         };
 
-        std::wstring  value;
-        std::wstring  alternative; // camel case version, if applicable
         std::uint32_t length = 0; // original length
         type          type {};
         char          string_type = 0; // 0, 'L', 'u', 'U', '8', 'R'
@@ -152,27 +793,214 @@ public:
 
         std::uint64_t integer = 0;
         double        decimal = 0.0;
+        std::uint32_t key = 0; // index of token text in 'vocabulary', see 'text'
+        std::uint32_t canonical = 0; // equal for tokens that compare equal as whole words
+        std::uint32_t specifiers = 0; // merged declaration specifiers, see 'merge_specifiers'
     };
 
     static const auto xxx = sizeof (token);
 
+    // text
+    //  - processed text of the token, interned in 'vocabulary', see 'widen'
+    //
+    wide_text text (const token & t) const {
+        return widen (this->vocabulary.entries [t.key].value);
+    }
+
 protected:
 
+    // stored
+    //  - text of the token in stored code units, for comparisons that don't need it converted
+    //
+    const unit_string & stored (const token & t) const {
+        return this->vocabulary.entries [t.key].value;
+    }
+
     // pattern
     //  - processed, converted and folded (according to 'parameters') source text
+    //  - segments are as large as 'vocabulary_set::block_size', appending doesn't reallocate and snapshots share them
+    //
+    agsearch_segmented_vector <token, 4096> pattern;
+
+    // vocabulary
+    //  - distinct token values, 'token::key' indexes 'entries'
+    //  - 'form' is lowercase value with diacritics removed, the most permissive folding used in any comparison
+    //  - 'trigrams' maps every 3 consecutive characters of every 'form' and 'alternative_form' to entries containing them
+    //  - 'subwords' are forms of camelCase/snake_case words, 'postings' list positions of all tokens containing them
+    //  - 'canonicals' are values folded exactly as 'parameters' specify for each token type, see 'token::canonical'
+    //  - 'kinds' list positions of all tokens of each 'token::type'
+    //  - 'rows' list position of first token at or after each row
+    //  - 'blocks' are Bloom filters of keys of every 'block_size' tokens, 'block_bits' bits each, see 'may_contain'
+    //  - 'numbers' are values and positions of all numeric tokens, sorted by value, see 'find_numbers'
+    //  - 'brackets' are all brackets in code, in order, with their paired bracket and brace depth; 'open' are those not closed yet
+    //  - sequences are segmented and maps shared, so 'snapshot' copies references only and changes copy what they touch:
+    //    segments of positions near the end, single posting lists, maps only when new distinct token appears
     //
-    std::vector <token> pattern;
+    struct vocabulary_set {
+        static constexpr std::uint32_t no_key = 0xFFFF'FFFF;
+        static constexpr std::size_t block_size = 4096;
+        static constexpr std::size_t block_bits = 8192;
+
+        struct subword {
+            unit_string   form;
+            std::uint32_t id;
+            std::uint32_t offset; // within 'value' converted to wide string, in which it was split
+            std::uint32_t length;
+        };
+        struct entry {
+            unit_string value;
+            unit_string form;
+            unit_string alternative; // camelCase version, if applicable
+            unit_string alternative_form;
+            std::vector <subword> subwords;
+            std::uint32_t canonical [5] = { no_key, no_key, no_key, no_key, no_key }; // by token type
+        };
+
+        using positions = agsearch_segmented_vector <std::uint32_t, block_size>;
+
+        agsearch_segmented_vector <entry, 1024> entries;
+        agsearch_shared <std::unordered_map <unit_string, std::uint32_t>> index;
+        agsearch_shared <std::unordered_map <std::uint64_t, std::vector <std::uint32_t>>> trigrams;
+
+        agsearch_shared <std::map <unit_string, std::uint32_t>> subwords;
+        agsearch_segmented_vector <agsearch_shared <std::vector <std::uint32_t>>, 1024> postings;
+        agsearch_shared <std::unordered_map <unit_string, std::uint32_t>> canonicals;
+        positions kinds [5];
+        agsearch_segmented_vector <std::uint64_t, block_bits / 2> blocks; // 32 blocks per segment
+        positions rows;
+        agsearch_shared <std::vector <std::pair <double, std::uint32_t>>> numbers;
+
+        struct bracket {
+            std::uint32_t position; // in 'pattern'
+            std::uint32_t partner; // index of paired bracket, 'no_key' if none
+            std::uint32_t depth; // braces enclosing the bracket
+            wchar_t       value; // '(', ')', '[', ']', '{' or '}'
+            bool          namespace_body; // '{' of namespace or 'extern "C"'
+        };
+        agsearch_segmented_vector <bracket, 4096> brackets;
+        std::vector <std::uint32_t> open;
+
+        std::size_t indexed = 0; // number of 'pattern' tokens already in 'postings'
+        std::size_t revision = 0; // changes with every change of 'pattern'
+    } vocabulary;
 
     // reordered pattern
     //  - we need second one not to lose resuls of other kinds of matches
     //
     // std::map <location, token> reordered;
 
-    // strings
-    //  - unprocessed/untokenized strings for plain-text search
-    //  - regular pattern contains tokenized string (searched like code)
+    // plaintext
+    //  - unprocessed/untokenized strings and comments for plain-text search
+    //  - regular pattern contains tokenized strings and comments (searched like code)
+    //  - whitespace runs are collapsed to single space, each string or comment is terminated by L'\0'
+    //  - 'folded' is 'text' case and diacritics -folded according to 'parameters', character by character
+    //  - with 'match_snake_and_camel_casing' underscores are left out of 'folded', e.g. max_size is found as maxSize,
+    //    'underscores' list their offsets in 'text'
+    //  - 'pieces' map offsets in 'text' to source locations, each covers contiguous characters of single row,
+    //    surrogate pairs stored for single 32-bit wchar_t start new piece, so that both code units map to its column
+    //  - all are segmented and shared with snapshots like 'pattern', needle is searched as plain text if it fits single segment
     //
-    // std::map <location, std::wstring> strings;
+    struct plaintext_set {
+        struct piece {
+            std::uint32_t offset;
+            location      location;
+        };
+        struct segment {
+            std::uint32_t    offset;
+            enum token::type type;
+        };
+
+        agsearch_segmented_vector <code_unit, 65536> text;
+        agsearch_segmented_vector <code_unit, 65536> folded;
+        agsearch_segmented_vector <std::uint32_t, 4096> underscores;
+        agsearch_segmented_vector <piece, 4096> pieces;
+        agsearch_segmented_vector <segment, 4096> segments;
+    } plaintext;
+
+public:
+    struct query {
+        std::wstring text;
+
+        std::unique_ptr <basic_agsearch> needle;
+        std::vector <std::vector <bool>> candidates; // by needle token, see 'resolve'
+        std::vector <bool> blocks; // blocks that can contain the needle, empty means all
+        typename vocabulary_set::positions starts; // positions where the needle can start, if 'use_starts'
+        int kind = -1; // if not negative, the needle can start at positions from 'vocabulary.kinds [kind]' instead
+        bool use_starts = false;
+        bool plaintext = false; // searching 'plaintext' instead of 'pattern'
+        std::optional <std::boyer_moore_horspool_searcher <typename unit_view::const_iterator>> searcher; // of plain text needle
+        bool done = false;
+
+        std::size_t position = 0; // where to continue in 'pattern' or 'plaintext'
+        std::size_t istart = 0; // where to continue in starts
+
+        std::size_t revision = 0; // 'vocabulary.revision' the query was compiled for
+        std::vector <std::uint32_t> found; // starts of instances found so far
+        std::vector <std::pair <std::size_t, std::size_t>> scanned; // merged ranges of 'pattern' positions searched so far
+
+        struct element {
+            enum class type : std::uint8_t {
+                token = 0,
+                identifier, // $id
+                numeric, // $num
+                any, // $any
+                gap, // $...
+            } type;
+            std::uint32_t token; // index of needle token, for 'type::token'
+            std::vector <std::pair <double, double>> ranges; // values of '$num', any if empty
+        };
+        std::vector <element> elements; // needle with wildcards, matched by automaton, see 'next_automaton'
+
+        std::vector <std::uint64_t> masks; // needle tokens equal to pattern token, by key and type, see 'mask'
+        std::vector <std::uint64_t> state; // needle prefixes matched at 'position', by number of errors, see 'next_approximate'
+        std::size_t start = 0; // first and last token of approximate instance that may still be replaced by better one
+        std::size_t end = (std::size_t) -1;
+        std::size_t errors = 0; // of that instance
+        std::size_t earliest = 0; // where next approximate instance can start
+    };
+
+    class match_range {
+        const basic_agsearch * search;
+        query                  q;
+        match                  current {};
+        bool                   started = false;
+        bool                   valid = false;
+
+        void advance () {
+            this->valid = this->search->next (this->q, this->current);
+            this->started = true;
+        }
+
+    public:
+        match_range (const basic_agsearch * search, query && q)
+            : search (search)
+            , q (std::move (q)) {}
+
+        struct iterator {
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = match;
+            using difference_type = std::ptrdiff_t;
+
+            match_range * range = nullptr;
+
+            const match & operator * () const { return this->range->current; }
+            iterator & operator ++ () { this->range->advance (); return *this; }
+            void operator ++ (int) { this->range->advance (); }
+            bool operator == (std::default_sentinel_t) const { return !this->range->valid; }
+        };
+
+        // begin
+        //  - searches for the first instance on first call only
+        //  - later calls return the current instance, i.e. the one previous iteration stopped at, without searching
+        //
+        iterator begin () {
+            if (!this->started) {
+                this->advance ();
+            }
+            return { this };
+        }
+        std::default_sentinel_t end () const { return {}; }
+    };
 
 private:
 
@@ -187,18 +1015,208 @@ private:
         enum token::type mode {}; // code, string or comment
         location         location { 0, 0 };
         char             string_type = 0;
+        std::uint32_t    plaintext = 0; // column where current string or comment text starts
+        std::uint32_t    conditionals = 0; // '?' tokens not yet paired with ':', see 'normalize_needle'
     } current;
 
     std::uint8_t single_line_comment = 0;
 
-    void normalize_needle ();
+    // lines
+    //  - state at the start of every processed line, 'reload' resumes processing from it
+    //
+    struct line_state {
+        std::size_t   hash;
+        std::uint32_t tokens; // 'pattern' size, after normalization position of first token at or after the line
+        std::uint32_t text; // 'plaintext' sizes
+        std::uint32_t pieces;
+        std::uint32_t segments;
+        code_unit     last; // last 'plaintext.text' character, closing string or comment on this line may change it
+        typename plaintext_set::segment segment {}; // last of 'plaintext.segments', closing empty one on this line removes it
+        decltype (current) lexer; // 'current' at the start of the line
+        std::uint8_t  single_line_comment;
+        bool          joined; // token preceding this line was removed later, see 'remove_last_token'
+    };
+    agsearch_segmented_vector <line_state, 4096> lines;
+
+    void normalize_needle (std::size_t from);
     void normalize_full ();
-    bool compare_tokens (const token &, const token &, std::uint32_t * first, std::uint32_t * last);
-    bool compare_strings (DWORD flags, const std::wstring &, const std::wstring &, std::uint32_t * first, std::uint32_t * last);
+    void index ();
+    void truncate (std::size_t row);
+    void reload_lines (std::span <const std::wstring_view>);
+    void merge_specifiers (std::size_t from);
+    bool compare_tokens (const token &, const token &, const vocabulary_set &, std::uint32_t * first, std::uint32_t * last) const;
+    bool compare_words (const token &, const token &, const vocabulary_set &, std::uint32_t * first, std::uint32_t * last) const;
+    bool compare_strings (DWORD flags, unit_view, unit_view, std::uint32_t * first, std::uint32_t * last) const;
+    static bool includes_specifiers (std::uint32_t, std::uint32_t);
+    bool compare_subwords (DWORD flags, const vocabulary_set::entry &, const vocabulary_set::entry &, std::uint32_t * first, std::uint32_t * last) const;
     void process_text (std::wstring_view text);
     void process_line (std::wstring_view line);
 
     std::wstring fold (std::wstring_view);
+    std::wstring make_form (std::wstring_view) const;
+    std::wstring simplify (std::wstring_view, bool lowercase, bool undiacritic) const;
+    unit_string canonical_form (const vocabulary_set::entry &, enum token::type) const;
+    std::uint32_t canonicalize (const token &);
+    std::wstring camel_case (std::wstring_view);
+    std::uint32_t intern (std::wstring_view);
+    std::vector <bool> resolve (const vocabulary_set::entry &) const;
+    std::vector <std::uint32_t> postings (const vocabulary_set::entry &) const;
+    bool may_contain (std::size_t block, std::uint32_t key) const;
+    std::vector <typename vocabulary_set::subword> split_subwords (std::wstring_view);
+    void remove_last_token ();
+
+    void open_plaintext ();
+    void append_plaintext (std::wstring_view text, location);
+    void close_plaintext ();
+    void fold_plaintext ();
+    location locate_plaintext (std::size_t offset) const;
+    static unit_view plaintext_needle (const basic_agsearch & needle);
+    bool next_plaintext (query &, match &, std::size_t limit) const;
+    bool next_automaton (query &, match &, std::size_t limit) const;
+    std::vector <std::uint32_t> numeric_positions (const std::vector <std::pair <double, double>> & ranges) const;
+
+    static double numeric_value (const token & t) {
+        return (double) t.integer + t.decimal; // whole part and fraction, see 'parse_decimal_part' and 'parse_decimal_exponent'
+    }
+
+    void seek (query &, std::size_t position) const;
+    std::pair <std::size_t, std::size_t> range (const query &, std::uint32_t first_row, std::uint32_t last_row) const;
+    bool extends (const query & previous, const query &) const;
+
+    template <typename Report>
+    std::size_t search_viewport (query & q, std::uint32_t first_row, std::uint32_t last_row,
+                                 const std::stop_token & cancel, const std::stop_token & stop, Report & report, std::size_t step) const {
+        if (q.done) {
+            report (std::span <const match> (), 0, 0);
+            return 0;
+        }
+
+        const auto total = q.plaintext ? this->plaintext.text.size () : this->pattern.size ();
+        auto [lo, hi] = this->range (q, first_row, last_row);
+
+        std::vector <match> batch;
+        std::size_t scanned = 0;
+        std::size_t n = 0;
+
+        // stop is requested either by the caller or by the task
+
+        auto stopped = [&cancel, &stop] () {
+            return cancel.stop_requested () || stop.stop_requested ();
+        };
+
+        // reports instances starting in [begin, end)
+
+        auto scan = [&] (std::size_t begin, std::size_t end) {
+            auto reported = begin;
+
+            this->seek (q, begin);
+            while ((q.position < end) && !q.done && !stopped ()) {
+                match m;
+                auto found = this->next (q, m, std::min (step, end - q.position));
+                if (found) {
+                    batch.push_back (m);
+                }
+                if (!found || (q.position - reported >= step)) {
+                    reported = std::min (q.position, end);
+                    report (std::span <const match> (batch), scanned + (reported - begin), total);
+
+                    n += batch.size ();
+                    batch.clear ();
+                }
+            }
+            if (!batch.empty ()) {
+                report (std::span <const match> (batch), scanned + (end - begin), total);
+
+                n += batch.size ();
+                batch.clear ();
+            }
+            scanned += end - begin;
+        };
+
+        scan (lo, hi);
+        while (((lo > 0) || (hi < total)) && !stopped ()) {
+            if (hi < total) {
+                auto end = (total - hi > step) ? hi + step : total;
+                scan (hi, end);
+                hi = end;
+            }
+            if (lo > 0) {
+                auto begin = (lo > step) ? lo - step : 0;
+                scan (begin, lo);
+                lo = begin;
+            }
+        }
+        if (!stopped ()) {
+            report (std::span <const match> (), total, total);
+        }
+        return n;
+    }
+
+    template <typename Visitor>
+    static bool visit (Visitor & visitor, const match & m) {
+        if constexpr (std::is_same_v <decltype (visitor (m.begin, m.end)), bool>) {
+            return visitor (m.begin, m.end);
+        } else {
+            visitor (m.begin, m.end);
+            return true;
+        }
+    }
+    std::size_t position (const query &, location) const;
+    std::size_t containing (const query &, location) const;
+
+    template <typename Visitor>
+    std::size_t visit_positions (const std::vector <std::uint32_t> & positions, Visitor & visitor) const {
+        std::size_t n = 0;
+        for (auto p : positions) {
+            const auto & t = this->pattern [p];
+            ++n;
+            if (!visit (visitor, { t.location, { t.location.row, t.location.column + t.length } }))
+                break;
+        }
+        return n;
+    }
+    std::uint64_t mask (query &, const token &) const;
+
+    // condition_state
+    //  - search for instances of 'condition' needle, 'current' is the first one not before rows of last tested instance
+    //  - with 'same_body' 'current' is the first one inside body starting at 'scope'
+    //
+    struct condition_state {
+        std::uint32_t rows;
+        bool          negated;
+        bool          same_body;
+        query         q;
+        match         current {};
+        bool          valid = false; // 'current' was found
+        location      scope { (std::uint32_t) -1, (std::uint32_t) -1 }; // begin of body last searched for 'same_body'
+    };
+    bool satisfied (condition_state &, const match &) const;
+    bool skip (query &, std::vector <condition_state> &) const;
+
+    wchar_t bracket_value (const token &) const;
+    bool opens_namespace (std::size_t position) const;
+    void index_bracket (std::uint32_t position);
+    void pair_bracket (std::uint32_t index);
+    void unindex_brackets (std::size_t position);
+    std::pair <location, location> body (location at) const;
+    std::vector <std::pair <location, location>> namespace_scope () const;
+
+    // visit_between
+    //  - calls 'visitor' for instances starting in [begin, end), counted in 'n', returns false when 'visitor' stopped the search
+    //
+    template <typename Visitor>
+    bool visit_between (query & q, location begin, location end, Visitor & visitor, std::size_t & n) const {
+        const auto last = this->position (q, end);
+        this->seek (q, this->position (q, begin));
+
+        match m;
+        while ((q.position < last) && this->next (q, m, last - q.position)) {
+            ++n;
+            if (!visit (visitor, m))
+                return false;
+        }
+        return true;
+    }
 
     bool is_identifier_initial (wchar_t);
     bool is_identifier_continuation (wchar_t);
@@ -222,5 +1240,45 @@ private:
     void append_numeric (std::wstring_view value, std::uint64_t integer, double * decimal, std::size_t advance);
 };
 
+// basic_agsearch_versions
+//  - writer edits its own instance and publishes snapshots of it, readers search the latest published one
+//  - readers keep the snapshot they took until they finish, so editing and searching never wait for each other
+//  - publishing copies only references to segments of the text and indexes, which are shared until changed
+//
+template <typename Config>
+class basic_agsearch_versions {
+public:
+    using searcher = basic_agsearch <Config>;
+
+    // edit
+    //  - calls 'f' (searcher &) to change the text, e.g. 'load' or 'append', then publishes new version
+    //  - concurrent edits are serialized
+    //
+    template <typename F>
+    void edit (F && f) {
+        std::lock_guard <std::mutex> lock (this->writing);
+        f (this->writer);
+        this->published.store (this->writer.snapshot ());
+    }
+
+    // current
+    //  - latest published version, empty searcher until the first edit
+    //
+    std::shared_ptr <const searcher> current () const {
+        return this->published.load ();
+    }
+
+private:
+    std::mutex writing;
+    searcher   writer;
+    std::atomic <std::shared_ptr <const searcher>> published { std::make_shared <const searcher> () };
+};
+
+// agsearch
+//  - searcher with runtime parameters
+//
+using agsearch = basic_agsearch <agsearch_dynamic_config>;
+using agsearch_versions = basic_agsearch_versions <agsearch_dynamic_config>;
+
 
 #endif
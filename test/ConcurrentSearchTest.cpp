@@ -0,0 +1,262 @@
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <span>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include "../agsearch.h"
+
+// ConcurrentSearchTest
+//  - searches single loaded instance from many threads at once and compares every result with single-threaded search
+//  - then searches snapshots published by 'agsearch_versions' while another thread keeps editing the text
+//  - prints first few differences, exits with 0 only when all results match
+//  - usage: ConcurrentSearchTest [threads] [rounds]
+//
+
+namespace {
+    using instance = std::tuple <std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t>; // begin row, column, end row, column
+    using results = std::vector <instance>;
+
+    // lines the text is generated from
+    //  - code, strings, comments, numbers and nested brackets, so that all indexes are used
+    //
+    const wchar_t * const lines [] = {
+        L"namespace app {",
+        L"int compute (int first_value, int secondValue) {",
+        L"    if (first_value > 10) return first_value * 2;",
+        L"    auto * buffer = static_cast <char *> (malloc (0x40));",
+        L"    free (buffer);",
+        L"    return secondValue ? first_value : -1;",
+        L"}",
+        L"struct widget : public base { unsigned long size = 42ul; };",
+        L"const char * name = \"Hello World of strings\";",
+        L"// max_buffer_size is the upper limit",
+        L"/* block comment about getHTTPResponse */ x = 3.5f;",
+        L"for (std::size_t i = 0; i != items.size (); ++i) { process (items [i]); }",
+        L"lock (); update (state); unlock ();",
+        L"}",
+    };
+
+    // needles searched by all threads
+    //
+    const wchar_t * const needles [] = {
+        L"first_value",
+        L"secondValue",
+        L"size",
+        L"return $id $...;",
+        L"$id ($id)",
+        L"malloc ($num)",
+        L"if ($...) return",
+        L"// max_buffer_size",
+        L"upper limit",
+        L"\"hello world\"",
+        L"{ process (items [i]); }",
+        L"42",
+        L"lock (); $any unlock ();",
+    };
+
+    std::vector <std::wstring> generate (std::size_t rows, unsigned seed) {
+        std::mt19937 random (seed);
+        std::vector <std::wstring> text;
+        text.reserve (rows);
+
+        for (std::size_t i = 0; i != rows; ++i) {
+            text.push_back (lines [random () % std::size (lines)]);
+        }
+        return text;
+    }
+
+    // search
+    //  - instances of needle 'n' found through one of the const search paths, 'path' selects which
+    //
+    enum path : unsigned {
+        find = 0,
+        matches,
+        next,
+        find_next,
+        find_previous,
+        approximate,
+        conditions,
+        paths
+    };
+
+    results search (const agsearch & searcher, std::size_t n, unsigned path) {
+        results r;
+        const auto add = [&r] (agsearch::location begin, agsearch::location end) {
+            r.push_back ({ begin.row, begin.column, end.row, end.column });
+        };
+
+        switch (path) {
+            case path::find:
+                searcher.find (needles [n], add);
+                break;
+
+            case path::matches:
+                for (const auto & m : searcher.matches (needles [n])) {
+                    add (m.begin, m.end);
+                }
+                break;
+
+            case path::next:
+                {
+                    auto q = searcher.compile (needles [n]);
+                    agsearch::match m;
+                    while (searcher.next (q, m)) {
+                        add (m.begin, m.end);
+                    }
+                }
+                break;
+
+            case path::find_next:
+                {
+                    auto q = searcher.compile (needles [n]);
+                    agsearch::match m;
+                    if (searcher.find_next (q, { 0, 0 }, m)) {
+                        do {
+                            add (m.begin, m.end);
+                        } while (searcher.next (q, m));
+                    }
+                }
+                break;
+
+            case path::find_previous:
+                {
+                    auto q = searcher.compile (needles [n]);
+                    agsearch::match m;
+                    agsearch::location from { (std::uint32_t) -1, 0 };
+                    while (searcher.find_previous (q, from, m)) {
+                        add (m.begin, m.end);
+                        from = m.begin;
+                    }
+                    std::reverse (r.begin (), r.end ());
+                }
+                break;
+
+            case path::approximate:
+                searcher.find_approximate (needles [n], 1, add);
+                break;
+
+            case path::conditions:
+                {
+                    const agsearch::condition near [] = { { L"return", 3 }, { L"unlock", 0, true } };
+                    searcher.find (needles [n], std::span <const agsearch::condition> (near), add);
+                }
+                break;
+        }
+        return r;
+    }
+
+    // differ
+    //  - compares instances starting before 'rows', those after may change while the text is being edited
+    //
+    bool differ (const results & a, const results & b, std::uint32_t rows = (std::uint32_t) -1) {
+        const auto before = [rows] (const instance & i) { return std::get <2> (i) < rows; };
+        results x, y;
+        std::copy_if (a.cbegin (), a.cend (), std::back_inserter (x), before);
+        std::copy_if (b.cbegin (), b.cend (), std::back_inserter (y), before);
+        return x != y;
+    }
+
+    std::atomic <std::size_t> failures = 0;
+    std::atomic <std::size_t> searches = 0;
+
+    void report (const char * phase, std::size_t n, unsigned path, const results & expected, const results & found) {
+        if (failures++ < 10) {
+            std::printf ("%s: '%ls' path %u found %zu instead of %zu instances\n",
+                         phase, needles [n], path, found.size (), expected.size ());
+        }
+    }
+}
+
+int main (int argc, char ** argv) {
+    const auto threads = (argc > 1) ? (unsigned) std::atoi (argv [1]) : std::max (4u, std::thread::hardware_concurrency ());
+    const auto rounds = (argc > 2) ? (unsigned) std::atoi (argv [2]) : 200u;
+
+    const auto text = generate (5000, 1);
+
+    agsearch searcher;
+    searcher.load (text);
+
+    // single-threaded results of every needle and path
+
+    std::vector <std::vector <results>> expected (std::size (needles));
+    for (std::size_t n = 0; n != std::size (needles); ++n) {
+        for (unsigned p = 0; p != path::paths; ++p) {
+            expected [n].push_back (search (searcher, n, p));
+        }
+    }
+
+    // the same searches from all threads at once, in different order in each thread
+
+    {
+        std::vector <std::jthread> workers;
+        for (unsigned t = 0; t != threads; ++t) {
+            workers.emplace_back ([&, t] {
+                std::mt19937 random (t);
+                for (unsigned r = 0; r != rounds; ++r) {
+                    const auto n = random () % std::size (needles);
+                    const auto p = random () % path::paths;
+                    const auto found = search (searcher, n, p);
+                    if (differ (expected [n][p], found)) {
+                        report ("shared instance", n, p, expected [n][p], found);
+                    }
+                    ++searches;
+                }
+            });
+        }
+    }
+
+    // snapshots searched while the writer appends lines and removes them again
+    //  - rows of the original text don't change, so instances starting there are compared
+    //  - the last original row is left out, as appended code may extend an instance from it
+
+    {
+        agsearch_versions versions;
+        versions.edit ([&text] (agsearch & s) { s.load (text); });
+
+        std::atomic <bool> editing = true;
+        std::jthread writer ([&] {
+            auto edited = text;
+            for (unsigned r = 0; r != rounds; ++r) {
+                if (r % 16 == 15) {
+                    edited.resize (text.size ());
+                } else {
+                    edited.push_back (lines [r % std::size (lines)]);
+                }
+                versions.edit ([&edited] (agsearch & s) { s.reload (edited); });
+            }
+            editing = false;
+        });
+
+        const auto rows = (std::uint32_t) text.size () - 1;
+
+        std::vector <std::jthread> readers;
+        for (unsigned t = 0; t != threads; ++t) {
+            readers.emplace_back ([&, t] {
+                std::mt19937 random (t);
+                for (unsigned r = 0; (r != rounds) || editing; ++r) {
+                    const auto snapshot = versions.current ();
+                    const auto n = random () % std::size (needles);
+                    const auto p = random () % path::paths;
+                    const auto found = search (*snapshot, n, p);
+                    if (differ (expected [n][p], found, rows)) {
+                        report ("snapshot", n, p, expected [n][p], found);
+                    }
+                    ++searches;
+                }
+            });
+        }
+    }
+
+    std::printf ("%zu searches in %u threads, %zu failed\n", searches.load (), threads, failures.load ());
+    return failures ? 1 : 0;
+}
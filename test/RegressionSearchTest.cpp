@@ -0,0 +1,188 @@
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <tuple>
+#include "../agsearch.h"
+
+// RegressionSearchTest
+//  - loads short texts and compares instances found for needles with expected ones
+//  - every case is a former bug, prints those that fail, exits with 0 only when all pass
+//  - usage: RegressionSearchTest
+//
+
+namespace {
+    using instance = std::tuple <std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t>; // begin row, column, end row, column
+    using results = std::vector <instance>;
+
+    struct regression {
+        std::vector <std::wstring>      text;
+        const wchar_t *                 needle;
+        bool agsearch_parameter_set::*  option; // enabled for this case only, or nullptr
+        results                         expected;
+    };
+
+    // integer declarations
+    //  - needle naming complete type finds only that type, however spelled
+
+    const std::vector <std::wstring> declarations = {
+        L"unsigned short a;",
+        L"short int unsigned b;",
+        L"unsigned int c;",
+        L"int unsigned d;",
+        L"long long e;",
+        L"long f;",
+        L"int g;",
+        L"unsigned h;",
+        L"signed int i;",
+    };
+
+    // string needle of several words
+    //  - searched as tokens unless plain-text search finds the same instances
+
+    const std::vector <std::wstring> strings = {
+        L"auto s = \"worldwide hello\";",
+        L"auto t = \"world hello\";",
+    };
+
+    // numbers
+    //  - fraction and leading '0' of floating point literals
+
+    const std::vector <std::wstring> numbers = {
+        L"a = 1.25;",
+        L"b = 0.5;",
+        L"c = 1.7;",
+        L"d = 017;",
+        L"e = 05e0;",
+    };
+
+    const regression regressions [] = {
+        { declarations, L"unsigned int", nullptr, { { 2, 0, 2, 12 }, { 3, 0, 3, 12 }, { 7, 0, 7, 8 } } },
+        { declarations, L"int", nullptr, { { 6, 0, 6, 3 }, { 8, 0, 8, 10 } } },
+        { declarations, L"int", &agsearch_parameter_set::whole_words, { { 6, 0, 6, 3 }, { 8, 0, 8, 10 } } },
+        { declarations, L"long", nullptr, { { 5, 0, 5, 4 } } },
+        { declarations, L"long long", nullptr, { { 4, 0, 4, 9 } } },
+        { declarations, L"unsigned short", nullptr, { { 0, 0, 0, 14 }, { 1, 0, 1, 18 } } },
+        { declarations, L"unsigned", nullptr, { { 0, 0, 0, 14 }, { 1, 0, 1, 18 }, { 2, 0, 2, 12 }, { 3, 0, 3, 12 }, { 7, 0, 7, 8 } } },
+        { strings, L"\"world hello\"", nullptr, { { 0, 10, 0, 25 }, { 1, 10, 1, 21 } } },
+        { strings, L"\"world hello\"", &agsearch_parameter_set::whole_words, { { 1, 10, 1, 21 } } },
+        { strings, L"\"wor hel\"", &agsearch_parameter_set::individual_partial_words, { { 0, 10, 0, 25 }, { 1, 10, 1, 21 } } },
+        { strings, L"\"hello\"", nullptr, { { 0, 20, 0, 25 }, { 1, 16, 1, 21 } } },
+        { numbers, L"0.5", nullptr, { { 1, 4, 1, 7 } } },
+        { numbers, L"1.7", nullptr, { { 2, 4, 2, 7 } } },
+        { numbers, L"= $num{0.5}", nullptr, { { 1, 2, 1, 7 } } },
+        { numbers, L"= $num[0.4, 0.6]", nullptr, { { 1, 2, 1, 7 } } },
+        { numbers, L"= $num{15, 5}", nullptr, { { 3, 2, 3, 7 }, { 4, 2, 4, 8 } } },
+    };
+
+    // reloads
+    //  - text 'edited' reloaded over 'text' must find the same instances as 'edited' loaded anew
+    //  - ':' is 'else' only when paired with '?', possibly on previous line
+
+    struct reload {
+        std::vector <std::wstring>  text;
+        std::vector <std::wstring>  edited;
+        const wchar_t *             needle;
+    };
+
+    const reload reloads [] = {
+        { { L"x = c ?", L"a : b;", L"if (d) e; else f;" }, { L"x = c;", L"a : b;", L"if (d) e; else f;" }, L"else" },
+        { { L"x = c;", L"a : b;", L"if (d) e; else f;" }, { L"x = c ?", L"a : b;", L"if (d) e; else f;" }, L"else" },
+    };
+
+    results search (const agsearch & searcher, const wchar_t * needle) {
+        results found;
+        searcher.find (needle, [&found] (agsearch::location begin, agsearch::location end) {
+            found.push_back ({ begin.row, begin.column, end.row, end.column });
+        });
+        return found;
+    }
+
+    // value ranges searched by 'find_numbers'
+
+    struct value_range {
+        std::vector <std::wstring>  text;
+        double                      low;
+        double                      high;
+        results                     expected;
+    };
+
+    const value_range value_ranges [] = {
+        { numbers, 1.25, 1.25, { { 0, 4, 0, 8 } } },
+        { numbers, 0.5, 0.5, { { 1, 4, 1, 7 } } },
+        { numbers, 0.4, 0.6, { { 1, 4, 1, 7 } } },
+        { numbers, 1.5, 2.0, { { 2, 4, 2, 7 } } },
+        { numbers, 5.0, 15.0, { { 3, 4, 3, 7 }, { 4, 4, 4, 8 } } },
+    };
+
+    results search (const regression & r) {
+        agsearch searcher;
+        if (r.option) {
+            searcher.parameters.*r.option = true;
+        }
+        searcher.load (r.text);
+        return search (searcher, r.needle);
+    }
+
+    void print (const char * label, const results & instances) {
+        std::printf ("  %s:", label);
+        for (const auto & [row, column, end_row, end_column] : instances) {
+            std::printf (" %u:%u-%u:%u", row, column, end_row, end_column);
+        }
+        std::printf ("\n");
+    }
+}
+
+int main () {
+    std::size_t failures = 0;
+
+    for (const auto & r : regressions) {
+        const auto found = search (r);
+        if (found != r.expected) {
+            std::printf ("'%ls' found %zu instead of %zu instances\n", r.needle, found.size (), r.expected.size ());
+            print ("expected", r.expected);
+            print ("found", found);
+            ++failures;
+        }
+    }
+
+    for (const auto & r : value_ranges) {
+        agsearch searcher;
+        searcher.load (r.text);
+
+        results found;
+        searcher.find_numbers (r.low, r.high, [&found] (agsearch::location begin, agsearch::location end) {
+            found.push_back ({ begin.row, begin.column, end.row, end.column });
+        });
+        if (found != r.expected) {
+            std::printf ("[%g, %g] found %zu instead of %zu numbers\n", r.low, r.high, found.size (), r.expected.size ());
+            print ("expected", r.expected);
+            print ("found", found);
+            ++failures;
+        }
+    }
+
+    for (const auto & r : reloads) {
+        agsearch loaded;
+        loaded.load (r.edited);
+
+        agsearch reloaded;
+        reloaded.load (r.text);
+        reloaded.reload (r.edited);
+
+        const auto expected = search (loaded, r.needle);
+        const auto found = search (reloaded, r.needle);
+        if (found != expected) {
+            std::printf ("'%ls' found %zu instead of %zu instances after reload\n", r.needle, found.size (), expected.size ());
+            print ("expected", expected);
+            print ("found", found);
+            ++failures;
+        }
+    }
+
+    std::printf ("%zu cases, %zu failed\n", std::size (regressions) + std::size (value_ranges) + std::size (reloads), failures);
+    return failures ? 1 : 0;
+}
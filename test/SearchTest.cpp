@@ -6,34 +6,71 @@
 #include <UXTheme.h>
 
 #include <cstddef>
+#include <mutex>
 #include "../agsearch.h"
 
 std::vector <std::wstring> file;
 std::vector <std::pair <agsearch::location, agsearch::location>> results;
+std::mutex results_lock;
 
 struct search : agsearch {
     using agsearch::pattern;
 
-    std::size_t find (std::wstring_view needle) {
-        ::results.clear ();
-        return this->agsearch::find (needle);
+    agsearch_task pending;
+    query previous;
+    query current;
+
+    // find
+    //  - cancels previous search and starts searching on background, results and progress are reported through WM_APP
+    //  - rows [first_row, last_row) currently visible are searched first
+    //  - while typing, last completed query narrows down where to search
+    //
+    void find (HWND hWnd, std::wstring_view needle, std::uint32_t first_row, std::uint32_t last_row, bool full) {
+        this->cancel ();
+        if (this->is_complete (this->current)) {
+            this->previous = std::move (this->current);
+        }
+        this->current = this->compile (needle, &this->previous);
+        this->pending = this->find_async (this->current, first_row, last_row, std::stop_token (),
+                                          [hWnd, full] (std::span <const match> batch, std::size_t scanned, std::size_t total) {
+                                              {
+                                                  std::lock_guard <std::mutex> lock (::results_lock);
+                                                  for (const auto & m : batch) {
+                                                      ::results.push_back ({ m.begin, m.end });
+                                                  }
+                                              }
+                                              PostMessage (hWnd, WM_APP, full, (LPARAM) (total ? 100 * scanned / total : 100));
+                                          });
     }
 
-    virtual bool found (std::wstring_view needle, std::size_t index, location begin, location end) override {
-        ::results.push_back ({ begin, end });
-        return true;
+    // cancel
+    //  - stops the background search and joins its thread, must precede any change to the searcher
+    //  - the search stops within single step, so this doesn't block the UI for long
+    //
+    void cancel () {
+        this->pending.stop ();
+
+        std::lock_guard <std::mutex> lock (::results_lock);
+        ::results.clear ();
     }
 
     std::size_t usage () const {
         auto cb = this->pattern.size () * sizeof (token);
-        for (const auto & token : this->pattern) {
-            if (token.value.length () >= 8) {
-                cb += token.value.length () * sizeof (wchar_t) + 8; // allocation overhead guess
-            }
-            if (token.alternative.length () >= 8) {
-                cb += token.alternative.length () * sizeof (wchar_t) + 8; // allocation overhead guess
-            }
+        for (const auto & entry : this->vocabulary.entries) {
+            cb += sizeof entry;
+            cb += (entry.value.length () + entry.form.length () + entry.alternative.length () + entry.alternative_form.length ()) * sizeof (code_unit);
+            cb += entry.subwords.size () * sizeof (vocabulary_set::subword);
+        }
+        for (const auto & list : this->vocabulary.postings) {
+            cb += list->size () * sizeof (std::uint32_t);
+        }
+        for (const auto & list : this->vocabulary.kinds) {
+            cb += list.size () * sizeof (std::uint32_t);
         }
+        cb += this->vocabulary.blocks.size () * sizeof (std::uint64_t);
+        cb += (this->plaintext.text.size () + this->plaintext.folded.size ()) * sizeof (code_unit);
+        cb += this->plaintext.pieces.size () * sizeof (plaintext_set::piece);
+        cb += this->plaintext.segments.size () * sizeof (plaintext_set::segment);
         return cb;
     }
 
@@ -45,17 +82,27 @@ public:
         QueryPerformanceFrequency (&this->perfhz);
         QueryPerformanceCounter (&this->perfT0);
     }
-    void report (HWND hWnd, bool full) const {
+    void report (HWND hWnd, bool full, unsigned int progress) const {
         LARGE_INTEGER perfT1;
         QueryPerformanceCounter (&perfT1);
 
         auto t = 1000.0 * double (perfT1.QuadPart - this->perfT0.QuadPart) / double (this->perfhz.QuadPart);
 
+        std::size_t n;
+        {
+            std::lock_guard <std::mutex> lock (::results_lock);
+            n = results.size ();
+        }
+
         wchar_t report [256];
-        std::swprintf (report, 256, L"%zu results in %.2f ms (%s) from %zu kB (%zu tokens)",
-                       results.size (), t,
-                       full ? L"FULL RESCAN AND SEARCH" : L"search only",
-                       this->usage () / 1024, this->pattern.size ());
+        if (progress < 100) {
+            std::swprintf (report, 256, L"%zu results in %.2f ms, searching %u%%", n, t, progress);
+        } else {
+            std::swprintf (report, 256, L"%zu results in %.2f ms (%s) from %zu kB (%zu tokens)",
+                           n, t,
+                           full ? L"FULL RESCAN AND SEARCH" : L"search only",
+                           this->usage () / 1024, this->pattern.size ());
+        }
 
         SetDlgItemText (hWnd, 902, report);
         InvalidateRect (hWnd, NULL, FALSE);
@@ -112,6 +159,8 @@ void UpdateScrollBar (HWND hWnd) {
 }
 
 void LoadFile (HWND hWnd, const wchar_t * path) {
+    search.cancel ();
+
     auto h = CreateFile (path, GENERIC_READ, 7, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
     if (h != INVALID_HANDLE_VALUE) {
 
@@ -194,8 +243,7 @@ void LoadFile (HWND hWnd, const wchar_t * path) {
     // clear GUI
 
     search.start ();
-    search.find (L"");
-    search.report (hWnd, true);
+    search.report (hWnd, true, 100);
 
     // and rest...
 
@@ -220,6 +268,7 @@ void Paint (HDC hDC, RECT rc) {
 
     // visualize search results
 
+    std::lock_guard <std::mutex> lock (results_lock);
     for (const auto & result : results) {
         auto points = 4u;
         POINT sp [2] = {
@@ -285,10 +334,11 @@ void Paint (HDC hDC, RECT rc) {
             SetBkMode (hDC, TRANSPARENT);
         }
 
+        const auto value = search.text (token);
         TextOut (hDC,
                  rc.left + character.cx * token.location.column,
                  rc.top + (character.cy - 2) * token.location.row + 7 - height * scrollbar.nPos,
-                 token.value.c_str (), (int) token.value.length ());
+                 value.data (), (int) value.length ());
 
         switch (token.type) {
             case search::token::type::identifier:
@@ -595,8 +645,7 @@ LRESULT CALLBACK Procedure (HWND hWnd, UINT message, WPARAM wParam, LPARAM lPara
                     switch (HIWORD (wParam)) {
                         case EN_CHANGE:
                             search.start ();
-                            search.find (GetCtrlText ((HWND) lParam));
-                            search.report (hWnd, false);
+                            search.find (hWnd, GetCtrlText ((HWND) lParam), scrollbar.nPos, scrollbar.nPos + scrollbar.nPage, false);
                             break;
                     }
                     break;
@@ -604,18 +653,23 @@ LRESULT CALLBACK Procedure (HWND hWnd, UINT message, WPARAM wParam, LPARAM lPara
                 default:
                     if (LOWORD (wParam) >= 1001 && LOWORD (wParam) < 1001 + nParameters) {
                         if (HIWORD (wParam) == BN_CLICKED) {
+                            search.cancel ();
                             reinterpret_cast <bool *> (&search.parameters) [LOWORD (wParam) - 1001] = (SendMessage ((HWND) lParam, BM_GETCHECK, 0, 0) == BST_CHECKED);
                             
                             search.start ();
                             search.load (file); // currently need to reload the file, most transformations are done at that time
-                            search.find (GetCtrlText (GetDlgItem (hWnd, 901)));
-                            search.report (hWnd, true);
+                            search.find (hWnd, GetCtrlText (GetDlgItem (hWnd, 901)), scrollbar.nPos, scrollbar.nPos + scrollbar.nPage, true);
                         }
                     }
             }
             break;
 
+        case WM_APP:
+            search.report (hWnd, (bool) wParam, (unsigned int) lParam);
+            break;
+
         case WM_CLOSE:
+            search.cancel ();
             PostQuitMessage ((int) wParam);
             break;
         case WM_ENDSESSION: